@@ -43,6 +43,95 @@ void uart_putc(char c, FILE *stream) {
 	}
 }
 
+#ifdef DBG_BINARY
+
+// The number of records that have been dropped since the last one that
+// has been sent.
+static uint16_t dropped_records = 0;
+
+/**
+ * Returns the number of bytes that can be added to the ringbuf without
+ * overwriting anything.
+ *
+ * Must be called with interrupts disabled.
+ */
+static uint16_t ringbuf_free() {
+	return (uart_ringbuf_pos - uart_ringbuf_end - 1) & RINGBUF_PTR_MASK;
+}
+
+/**
+ * Adds a single byte to the ringbuf; there must be space for it.
+ *
+ * Must be called with interrupts disabled.
+ */
+static void ringbuf_push(uint8_t c) {
+	uart_ringbuf[uart_ringbuf_end++] = c;
+	uart_ringbuf_end &= RINGBUF_PTR_MASK;
+}
+
+/**
+ * Adds a record header to the ringbuf.
+ *
+ * Must be called with interrupts disabled.
+ */
+static void ringbuf_push_header(const char *format, uint8_t length) {
+	uint16_t address = (uint16_t) (uintptr_t) format;
+
+	ringbuf_push(DBG_RECORD_SYNC);
+	ringbuf_push(address & 0xff);
+	ringbuf_push(address >> 8);
+	ringbuf_push(length);
+}
+
+void dbg_record_begin(struct dbg_record *record, const char *format) {
+	record->format = format;
+	record->length = 0;
+}
+
+void dbg_record_add(struct dbg_record *record, const void *arg, uint8_t size) {
+	if (record->length + 1 + size > DBG_RECORD_MAX_PAYLOAD) {
+		return;
+	}
+
+	record->payload[record->length++] = size;
+	for (uint8_t i = 0; i < size; i++) {
+		record->payload[record->length++] = ((const uint8_t *) arg)[i];
+	}
+}
+
+void dbg_record_commit(struct dbg_record *record) {
+	// Header plus payload, and the same for a record about dropped records.
+	uint16_t size = 4 + record->length;
+	uint16_t dropped_size = 4 + 1 + sizeof(dropped_records);
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (dropped_records && ringbuf_free() >= dropped_size + size) {
+			ringbuf_push_header(NULL, 1 + sizeof(dropped_records));
+			ringbuf_push(sizeof(dropped_records));
+			ringbuf_push(dropped_records & 0xff);
+			ringbuf_push(dropped_records >> 8);
+			dropped_records = 0;
+		}
+
+		if (dropped_records == 0 && ringbuf_free() >= size) {
+			ringbuf_push_header(record->format, record->length);
+			for (uint8_t i = 0; i < record->length; i++) {
+				ringbuf_push(record->payload[i]);
+			}
+
+			// The ringbuf now has contents -> enable the TX
+			// interrupt.
+			UCSR0B |= (1 << UDRIE0);
+		} else {
+			// Unlike text, a partially overwritten record can't
+			// be told apart from garbage; drop the new one.
+			dropped_records++;
+		}
+	}
+}
+
+#endif
+
 /**
  * This ISR is enabled via UDRIE0 whenever the ringbuf has conents.
  * Even if the ringbuf is empty, it may be activated without consequence.
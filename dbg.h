@@ -1,15 +1,37 @@
 // Conditionally provides functions for flashing LEDs, and links printf to
 // the UART through a ringbuffer.
+//
+// If DBG_BINARY is defined, printf and puts don't format anything on the
+// target; instead, a binary record with the flash address of the format
+// string and the raw arguments is sent. tools/dbgdecode.py expands the
+// records back to text, using the format strings from the ELF file.
+//
+// If BENCHMARK is defined, dbg_benchmark logs the CPU cycles that the
+// statements passed to it take; otherwise, it just runs them.
 
 #ifndef DCF77AVR_DBG_H_
 #define DCF77AVR_DBG_H_
 
+// Also without debugging, so that stdio.h is never parsed after the macros
+// that replace printf and puts.
+#include <stdio.h>
+
 #ifndef NDEBUG
 
-#include <stdio.h>
+#include <stdint.h>
 
 #include <avr/pgmspace.h>
 
+#include "util.h"
+
+#ifdef BENCHMARK
+#include "monotime.h"
+
+#ifdef MONOTIME_TICKLESS
+#error "BENCHMARK needs the periodic monotime; tickless counts are 1024 CPU cycles long."
+#endif
+#endif
+
 /**
  * Initializes the debugging LEDs and printf stdout.
  */
@@ -25,9 +47,116 @@ void dbg_toggle_yellow();
  */
 void dbg_toggle_red();
 
+#ifdef DBG_BINARY
+
+/**
+ * Binary records look like this:
+ *
+ *     DBG_RECORD_SYNC, format address (2 bytes, LSB first), payload
+ *     length (1 byte), payload
+ *
+ * The payload holds each argument as its size in bytes (1 byte), followed
+ * by its raw (little endian) bytes.
+ *
+ * A record with the format address 0 reports that records have been
+ * dropped because the ringbuffer was full; its argument is the number of
+ * dropped records.
+ */
+#define DBG_RECORD_SYNC 0xa5
+
+// Arguments that don't fit into the payload anymore are left out.
+#define DBG_RECORD_MAX_PAYLOAD 48
+
+struct dbg_record {
+	const char *format;
+	uint8_t length;
+	uint8_t payload[DBG_RECORD_MAX_PAYLOAD];
+};
+
+/**
+ * Starts a record for the given format string (in flash).
+ */
+void dbg_record_begin(struct dbg_record *record, const char *format);
+
+/**
+ * Appends an argument to the record.
+ */
+void dbg_record_add(struct dbg_record *record, const void *arg, uint8_t size);
+
+/**
+ * Sends the record; if it doesn't fit into the ringbuffer, it is dropped
+ * as a whole (and counted).
+ *
+ * Interrupt-safe.
+ */
+void dbg_record_commit(struct dbg_record *record);
+
+// Invokes M for each of up to 8 arguments.
+#define DBG_NARGS(...) DBG_NARGS_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define DBG_NARGS_(a1, a2, a3, a4, a5, a6, a7, a8, n, ...) n
+#define DBG_CONCAT(a, b) DBG_CONCAT_(a, b)
+#define DBG_CONCAT_(a, b) a##b
+#define DBG_FOR_EACH(M, ...) \
+	DBG_CONCAT(DBG_FOR_EACH_, DBG_NARGS(__VA_ARGS__))(M, __VA_ARGS__)
+#define DBG_FOR_EACH_1(M, a) M(a)
+#define DBG_FOR_EACH_2(M, a, ...) M(a) DBG_FOR_EACH_1(M, __VA_ARGS__)
+#define DBG_FOR_EACH_3(M, a, ...) M(a) DBG_FOR_EACH_2(M, __VA_ARGS__)
+#define DBG_FOR_EACH_4(M, a, ...) M(a) DBG_FOR_EACH_3(M, __VA_ARGS__)
+#define DBG_FOR_EACH_5(M, a, ...) M(a) DBG_FOR_EACH_4(M, __VA_ARGS__)
+#define DBG_FOR_EACH_6(M, a, ...) M(a) DBG_FOR_EACH_5(M, __VA_ARGS__)
+#define DBG_FOR_EACH_7(M, a, ...) M(a) DBG_FOR_EACH_6(M, __VA_ARGS__)
+#define DBG_FOR_EACH_8(M, a, ...) M(a) DBG_FOR_EACH_7(M, __VA_ARGS__)
+
+#define DBG_RECORD_ARG(arg) { \
+	__typeof__(arg) dbg_arg = (arg); \
+	dbg_record_add(&dbg_log_record, &dbg_arg, sizeof(dbg_arg)); \
+}
+
+#define DBG_LOG(format, args) do { \
+	struct dbg_record dbg_log_record; \
+	dbg_record_begin(&dbg_log_record, PSTR(format)); \
+	args \
+	dbg_record_commit(&dbg_log_record); \
+} while (0)
+
+#define printf(format, ...) \
+	DBG_LOG(format, DBG_FOR_EACH(DBG_RECORD_ARG, __VA_ARGS__))
+#define puts(str) DBG_LOG(str, )
+
+// %B is only understood by tools/dbgdecode.py.
+#define dbg_print_binary_64(label, val) \
+	printf(label "%B\n", (uint64_t) (val))
+
+#else
+
 #define printf(format, ...) printf_P(PSTR(format), __VA_ARGS__)
 #define puts(str) fputs_P(PSTR(str), stdout)
 
+#define dbg_print_binary_64(label, val) do { \
+	puts(label); \
+	print_binary_64(stdout, (val)); \
+	putc('\n', stdout); \
+} while (0)
+
+#endif
+
+#ifdef BENCHMARK
+/**
+ * Runs the given statements, and logs the CPU cycles they have taken, to a
+ * Timer 1 count (MONOTIME_TIMER_PRESCALER cycles). Includes the interrupts
+ * that have run meanwhile, and reading the timer itself.
+ */
+#define dbg_benchmark(label, ...) do { \
+	uint32_t dbg_benchmark_start = monotime_ticks_get(); \
+	__VA_ARGS__; \
+	uint32_t dbg_benchmark_cycles = (monotime_ticks_get() - \
+		dbg_benchmark_start) * MONOTIME_TIMER_PRESCALER; \
+	printf(label " in %lu cycles.\n", dbg_benchmark_cycles); \
+} while (0)
+#else
+#define dbg_benchmark(label, ...) do { __VA_ARGS__; } while (0)
+#endif
+
 #else
 
 #define dbg_init(...) do {} while (0)
@@ -37,6 +166,8 @@ void dbg_toggle_red();
 #define printf(...) do {} while (0)
 #define puts(...) do {} while (0)
 #define putc(...) do {} while (0)
+#define dbg_print_binary_64(...) do {} while (0)
+#define dbg_benchmark(label, ...) do { __VA_ARGS__; } while (0)
 
 #endif
 
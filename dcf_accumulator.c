@@ -0,0 +1,194 @@
+#include "dcf_accumulator.h"
+
+#include <stdint.h>
+
+#include "dbg.h"
+#include "dcf_classifier.h"
+#include "dcf_frame.h"
+#include "util.h"
+
+// The monotime that passes in one minute.
+#define MINUTE_MONOTIME ((uint32_t) 60 << 8)
+
+// Frames that are older than this many minutes don't take part in votes.
+#define MAX_AGE 15
+
+// Bits with a confidence below this value count as a half vote.
+#define WEAK_CONFIDENCE (DCF_CONFIDENCE_MAX / 2)
+
+/**
+ * A frame as stored in the accumulator.
+ */
+struct accumulated_frame {
+	// The 59 bits, without the leading '1' bit.
+	uint64_t bits;
+	// As in struct dcf_frame.
+	uint64_t erasures;
+	// Marks the bits with a confidence below WEAK_CONFIDENCE.
+	uint64_t weak;
+
+	uint32_t timestamp_monotime;
+};
+
+static struct accumulated_frame frames[DCF_ACCUMULATOR_FRAMES];
+
+// The number of valid entries in frames.
+static uint8_t frame_count = 0;
+
+// The index of the most recently added frame.
+static uint8_t frame_latest = 0;
+
+void dcf_accumulator_add(struct dcf_frame *frame) {
+	if ((frame->bits >> DCF_FRAME_BITS) != 1) {
+		return;
+	}
+
+	frame_latest = (frame_latest + 1) % DCF_ACCUMULATOR_FRAMES;
+	if (frame_count < DCF_ACCUMULATOR_FRAMES) {
+		frame_count++;
+	}
+
+	struct accumulated_frame *entry = &frames[frame_latest];
+	entry->bits = frame->bits & ~((uint64_t) 1 << DCF_FRAME_BITS);
+	entry->erasures = frame->erasures;
+	entry->weak = 0;
+	for (uint8_t i = 0; i < DCF_FRAME_BITS; i++) {
+		if (frame->confidence[i] < WEAK_CONFIDENCE) {
+			entry->weak |= (uint64_t) 1 << i;
+		}
+	}
+	entry->timestamp_monotime = frame->timestamp_monotime;
+}
+
+/**
+ * Advances the minute and hour fields of a stored frame by the given number
+ * of minutes.
+ *
+ * Once re-encoded, a wrong bit would affect the whole field, so only
+ * fields that have passed their parity check are advanced.
+ *
+ * @param erasures:
+ *     Fields that can't be advanced (because they contain erasures or
+ *     garbage) are marked as erased here.
+ */
+static uint64_t advance_frame(uint64_t bits, uint64_t *erasures,
+	uint8_t minutes) {
+
+	uint8_t minute = dcf_frame_read_bcd(bits, 37, 3);
+	if ((*erasures & DCF_FIELD_MINUTE) || minute >= 60 ||
+	    !dcf_frame_parity_ok(bits, DCF_FIELD_MINUTE)) {
+		// Let the others decide.
+		*erasures |= DCF_FIELD_MINUTE;
+		return bits;
+	}
+
+	minute += minutes;
+	bits = dcf_frame_write_bcd(bits, 37, 3, minute % 60);
+	bits = dcf_frame_set_parity(bits, DCF_FIELD_MINUTE);
+
+	if (minute < 60) {
+		return bits;
+	}
+
+	uint8_t hour = dcf_frame_read_bcd(bits, 29, 2);
+	if ((*erasures & DCF_FIELD_HOUR) || hour >= 24 ||
+	    !dcf_frame_parity_ok(bits, DCF_FIELD_HOUR)) {
+		*erasures |= DCF_FIELD_HOUR;
+		return bits;
+	}
+
+	hour += minute / 60;
+	bits = dcf_frame_write_bcd(bits, 29, 2, hour % 24);
+	bits = dcf_frame_set_parity(bits, DCF_FIELD_HOUR);
+
+	if (hour >= 24) {
+		// The date has changed as well; don't bother.
+		*erasures |= DCF_FIELD_DATE;
+	}
+
+	return bits;
+}
+
+uint8_t dcf_accumulator_vote(struct dcf_frame *result) {
+	struct accumulated_frame *latest = &frames[frame_latest];
+
+	// The sum of the votes for each bit; positive for 1.
+	int8_t votes[DCF_FRAME_BITS];
+	for (uint8_t i = 0; i < DCF_FRAME_BITS; i++) {
+		votes[i] = 0;
+	}
+
+	uint8_t voters = 0;
+
+	for (uint8_t n = 0; n < frame_count; n++) {
+		// Go back n frames from the most recent one.
+		uint8_t index = (frame_latest + DCF_ACCUMULATOR_FRAMES - n) %
+		                DCF_ACCUMULATOR_FRAMES;
+		struct accumulated_frame *entry = &frames[index];
+
+		// How many minutes ago was this frame received?
+		uint32_t age = latest->timestamp_monotime -
+		               entry->timestamp_monotime;
+		uint32_t minutes = (age + MINUTE_MONOTIME / 2) / MINUTE_MONOTIME;
+		int32_t error = (int32_t) (age - minutes * MINUTE_MONOTIME);
+		if (minutes > MAX_AGE || error > 0x100 || error < -0x100) {
+			// Stale, or not aligned to the minute grid.
+			continue;
+		}
+
+		uint64_t erasures = entry->erasures;
+		uint64_t bits = entry->bits;
+		if (minutes) {
+			bits = advance_frame(bits, &erasures, minutes);
+		}
+
+		for (uint8_t i = 0; i < DCF_FRAME_BITS; i++) {
+			if (BIT(erasures, i)) {
+				continue;
+			}
+
+			int8_t weight = BIT(entry->weak, i) ? 1 : 2;
+			votes[i] += BIT(bits, i) ? weight : -weight;
+		}
+
+		voters++;
+	}
+
+	printf("Voting on %hd frames.\n", voters);
+
+	if (voters < DCF_ACCUMULATOR_MIN_FRAMES) {
+		return 0;
+	}
+
+	result->bits = (uint64_t) 1 << DCF_FRAME_BITS;
+	result->erasures = 0;
+	result->timestamp_monotime = latest->timestamp_monotime;
+
+	for (uint8_t i = 0; i < DCF_FRAME_MAX_BITS; i++) {
+		if (i >= DCF_FRAME_BITS || votes[i] == 0) {
+			result->confidence[i] = 0;
+			if (i < DCF_FRAME_BITS) {
+				result->erasures |= (uint64_t) 1 << i;
+			}
+			continue;
+		}
+
+		int8_t margin = votes[i];
+		if (margin > 0) {
+			result->bits |= (uint64_t) 1 << i;
+		} else {
+			margin = -margin;
+		}
+
+		// A margin of 2 * DCF_ACCUMULATOR_MIN_FRAMES (all frames agree
+		// with full confidence) gives full confidence.
+		uint16_t confidence = (uint16_t) margin * DCF_CONFIDENCE_MAX /
+		                      (2 * DCF_ACCUMULATOR_MIN_FRAMES);
+		if (confidence > DCF_CONFIDENCE_MAX) {
+			confidence = DCF_CONFIDENCE_MAX;
+		}
+		result->confidence[i] = confidence;
+	}
+
+	return 1;
+}
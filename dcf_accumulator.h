@@ -0,0 +1,50 @@
+// Accumulates the last few received frames, and votes on them bit-by-bit.
+//
+// Most of the bits of a frame change only once per hour or day, so a
+// frame that has been voted from several noisy frames may pass the checks
+// even if none of the individual frames does.
+
+#ifndef DCF77AVR_DCF_ACCUMULATOR_H_
+#define DCF77AVR_DCF_ACCUMULATOR_H_
+
+#include <stdint.h>
+
+#include "dcf_receiver.h"
+
+/**
+ * The number of frames that are kept for voting.
+ */
+#define DCF_ACCUMULATOR_FRAMES 5
+
+/**
+ * The minimum number of frames that need to take part in a vote.
+ */
+#define DCF_ACCUMULATOR_MIN_FRAMES 3
+
+/**
+ * Adds a received frame to the accumulator, replacing the oldest one.
+ *
+ * Only frames with exactly 59 bits (i.e. without a leap second) are
+ * accepted; other frames are ignored.
+ */
+void dcf_accumulator_add(struct dcf_frame *frame);
+
+/**
+ * Votes on the accumulated frames.
+ *
+ * Each frame is advanced to the minute of the most recently added frame
+ * (by incrementing its minute and, if necessary, hour fields) before
+ * voting; frames that would need their date advanced don't vote on the
+ * date bits.
+ * Bits with a tied vote are marked as erasures.
+ *
+ * @param result:
+ *     The voted frame is stored here. Its timestamp is the one of the
+ *     most recently added frame.
+ * @returns
+ *     1 if at least DCF_ACCUMULATOR_MIN_FRAMES frames took part in the
+ *     vote, 0 else.
+ */
+uint8_t dcf_accumulator_vote(struct dcf_frame *result);
+
+#endif
@@ -0,0 +1,258 @@
+#include "dcf_classifier.h"
+
+#include <stdint.h>
+
+#include "dbg.h"
+
+// Initial windows for the length of the positive duty cycle.
+#define DCF_BIT0_MIN DCF_TICKS(10, 256)
+#define DCF_BIT0_MAX DCF_TICKS(33, 256)
+#define DCF_BIT1_MIN DCF_TICKS(44, 256)
+#define DCF_BIT1_MAX DCF_TICKS(59, 256)
+
+// Initial window for the length of a regular second's gap plus the pulse
+// before it, i.e. the time between the starts of two seconds; the
+// minute-end marker window is the same, plus one second.
+#define DCF_SECOND_MIN DCF_TICKS(224, 256)
+#define DCF_SECOND_MAX DCF_TICKS(288, 256)
+#define DCF_MINUTE_OFFSET DCF_TICKS(1, 1)
+
+// Nominal pulse lengths, and the nominal length of a second (pulse plus
+// gap).
+#define DCF_BIT0_NOMINAL DCF_TICKS(1, 10)
+#define DCF_BIT1_NOMINAL DCF_TICKS(2, 10)
+#define DCF_SECOND_NOMINAL DCF_TICKS(1, 1)
+
+// The maximum distance by which any window may be moved.
+#define DCF_ADAPT_LIMIT DCF_TICKS(8, 256)
+
+// Durations slightly outside of the current windows are still taken into
+// account when re-centering, so the windows can follow a drift.
+#define DCF_ADAPT_MARGIN DCF_TICKS(4, 256)
+
+// The minimum number of recorded durations required to move a window.
+#define DCF_ADAPT_MIN_SAMPLES 16
+
+#define HISTOGRAM_BINS 64
+
+/**
+ * Counts recorded durations in bins of equal width.
+ *
+ * Once a bin would overflow, all bins are halved, so old durations
+ * gradually lose their weight.
+ */
+struct histogram {
+	// The duration at the lower end of bin 0, in Timer 1 counts.
+	uint32_t origin;
+	// The width of each bin, in Timer 1 counts.
+	uint32_t bin_width;
+
+	uint8_t bins[HISTOGRAM_BINS];
+};
+
+// Covers 0 s to 0.25 s in steps of 1/256 s.
+static struct histogram pulse_histogram = {
+	0, DCF_TICKS(1, 256), {0}
+};
+
+// Covers 0.81 s to 1.31 s in steps of 1/128 s; records gaps plus the
+// pulses before them.
+static struct histogram gap_histogram = {
+	DCF_TICKS(208, 256), DCF_TICKS(2, 256), {0}
+};
+
+/**
+ * The current decision windows, in Timer 1 counts.
+ */
+static uint32_t bit0_min, bit0_max;
+static uint32_t bit1_min, bit1_max;
+static uint32_t second_min, second_max;
+
+/**
+ * The current expected pulse lengths, and the 0/1 decision threshold in
+ * between them, in Timer 1 counts.
+ */
+static uint32_t bit0_center, bit1_center, bit_threshold;
+
+void dcf_classifier_init() {
+	bit0_min = DCF_BIT0_MIN;
+	bit0_max = DCF_BIT0_MAX;
+	bit1_min = DCF_BIT1_MIN;
+	bit1_max = DCF_BIT1_MAX;
+	second_min = DCF_SECOND_MIN;
+	second_max = DCF_SECOND_MAX;
+	bit0_center = DCF_BIT0_NOMINAL;
+	bit1_center = DCF_BIT1_NOMINAL;
+	bit_threshold = (DCF_BIT0_NOMINAL + DCF_BIT1_NOMINAL) / 2;
+
+	for (uint8_t i = 0; i < HISTOGRAM_BINS; i++) {
+		pulse_histogram.bins[i] = 0;
+		gap_histogram.bins[i] = 0;
+	}
+}
+
+/**
+ * Records a single duration in the histogram.
+ * Durations outside of the histogram's range are ignored.
+ */
+static void histogram_record(struct histogram *h, uint32_t duration) {
+	if (duration < h->origin) {
+		return;
+	}
+
+	uint32_t bin = (duration - h->origin) / h->bin_width;
+	if (bin >= HISTOGRAM_BINS) {
+		return;
+	}
+
+	if (h->bins[bin] == 0xff) {
+		for (uint8_t i = 0; i < HISTOGRAM_BINS; i++) {
+			h->bins[i] >>= 1;
+		}
+	}
+
+	h->bins[bin]++;
+}
+
+/**
+ * Determines by how much the window [min, max] needs to be moved so that
+ * its nominal center coincides with the mean of the recorded durations
+ * inside of it.
+ *
+ * @returns
+ *     The shift in Timer 1 counts, limited to +-DCF_ADAPT_LIMIT; 0 if
+ *     there are not enough recorded durations.
+ */
+static int32_t histogram_shift(struct histogram *h, uint32_t min,
+	uint32_t max, uint32_t nominal) {
+
+	uint16_t count = 0;
+	uint32_t weighted_sum = 0;
+
+	uint32_t bin_center = h->origin + h->bin_width / 2;
+	for (uint8_t i = 0; i < HISTOGRAM_BINS; i++) {
+		if (bin_center + DCF_ADAPT_MARGIN >= min &&
+		    bin_center <= max + DCF_ADAPT_MARGIN) {
+
+			count += h->bins[i];
+			weighted_sum += (uint32_t) h->bins[i] * i;
+		}
+
+		bin_center += h->bin_width;
+	}
+
+	if (count < DCF_ADAPT_MIN_SAMPLES) {
+		return 0;
+	}
+
+	// Split the division to avoid overflowing the multiplication.
+	uint32_t mean = h->origin + h->bin_width / 2;
+	mean += (weighted_sum / count) * h->bin_width;
+	mean += (weighted_sum % count) * h->bin_width / count;
+
+	int32_t shift = (int32_t) (mean - nominal);
+	if (shift > (int32_t) DCF_ADAPT_LIMIT) {
+		shift = DCF_ADAPT_LIMIT;
+	} else if (shift < -(int32_t) DCF_ADAPT_LIMIT) {
+		shift = -(int32_t) DCF_ADAPT_LIMIT;
+	}
+
+	return shift;
+}
+
+/**
+ * Scales the distance between duration and threshold to
+ * 0..DCF_CONFIDENCE_MAX, with DCF_CONFIDENCE_MAX being reached at the
+ * distance between center and threshold.
+ *
+ * Durations on the wrong side of the threshold have confidence 0.
+ */
+static uint8_t pulse_confidence(uint32_t duration, uint32_t center) {
+	uint32_t distance, range;
+	if (center < bit_threshold) {
+		if (duration >= bit_threshold) {
+			return 0;
+		}
+		distance = bit_threshold - duration;
+		range = bit_threshold - center;
+	} else {
+		if (duration <= bit_threshold) {
+			return 0;
+		}
+		distance = duration - bit_threshold;
+		range = center - bit_threshold;
+	}
+
+	if (distance >= range) {
+		return DCF_CONFIDENCE_MAX;
+	}
+
+	// range is at most a few 100000 counts, so this can't overflow.
+	return (distance * DCF_CONFIDENCE_MAX) / range;
+}
+
+uint8_t dcf_classify_pulse(uint32_t duration, uint8_t *confidence) {
+	histogram_record(&pulse_histogram, duration);
+
+	if ((duration >= bit0_min) && (duration <= bit0_max)) {
+		*confidence = pulse_confidence(duration, bit0_center);
+		return DCF_PULSE_0;
+	}
+
+	if ((duration >= bit1_min) && (duration <= bit1_max)) {
+		*confidence = pulse_confidence(duration, bit1_center);
+		return DCF_PULSE_1;
+	}
+
+	*confidence = 0;
+	return DCF_PULSE_INVALID;
+}
+
+uint8_t dcf_classify_gap(uint32_t duration, uint32_t pulse) {
+	// A gap is as much shorter as the pulse before it is longer, so the
+	// window is applied to the start of the next second instead; it
+	// doesn't depend on the bit then.
+	duration += pulse;
+
+	if ((duration >= second_min) && (duration <= second_max)) {
+		histogram_record(&gap_histogram, duration);
+		return DCF_GAP_SECOND;
+	}
+
+	if ((duration >= second_min + DCF_MINUTE_OFFSET) &&
+	    (duration <= second_max + DCF_MINUTE_OFFSET)) {
+		histogram_record(&gap_histogram, duration - DCF_MINUTE_OFFSET);
+		return DCF_GAP_MINUTE;
+	}
+
+	histogram_record(&gap_histogram, duration);
+	return DCF_GAP_INVALID;
+}
+
+void dcf_classifier_adapt() {
+	int32_t shift0 = histogram_shift(&pulse_histogram,
+		bit0_min, bit0_max, DCF_BIT0_NOMINAL);
+	int32_t shift1 = histogram_shift(&pulse_histogram,
+		bit1_min, bit1_max, DCF_BIT1_NOMINAL);
+	int32_t shift_second = histogram_shift(&gap_histogram,
+		second_min, second_max, DCF_SECOND_NOMINAL);
+
+	bit0_min = DCF_BIT0_MIN + shift0;
+	bit0_max = DCF_BIT0_MAX + shift0;
+	bit1_min = DCF_BIT1_MIN + shift1;
+	bit1_max = DCF_BIT1_MAX + shift1;
+	second_min = DCF_SECOND_MIN + shift_second;
+	second_max = DCF_SECOND_MAX + shift_second;
+	bit0_center = DCF_BIT0_NOMINAL + shift0;
+	bit1_center = DCF_BIT1_NOMINAL + shift1;
+	bit_threshold = (bit0_center + bit1_center) / 2;
+
+	if (bit0_max >= bit1_min) {
+		// The windows would overlap; split them at the threshold.
+		bit0_max = bit_threshold - 1;
+		bit1_min = bit_threshold;
+	}
+
+	printf("Pulse windows shifted by %ld/%ld, gap window by %ld.\n",
+		shift0, shift1, shift_second);
+}
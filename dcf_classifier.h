@@ -0,0 +1,84 @@
+// Classifies the durations of the DCF77 signal levels.
+//
+// The decision windows start out at fixed values; histograms of the
+// observed durations are kept, and the windows are periodically re-centered
+// on them (within safe bounds) to adapt to the pulse-stretching
+// characteristics of the receiver.
+
+#ifndef DCF77AVR_DCF_CLASSIFIER_H_
+#define DCF77AVR_DCF_CLASSIFIER_H_
+
+#include <stdint.h>
+
+#include "monotime.h"
+
+/**
+ * Converts a duration of num/den seconds to Timer 1 counts.
+ */
+#define DCF_TICKS(num, den) \
+	((uint32_t) ((uint64_t) (num) * MONOTIME_TIMER_HZ / (den)))
+
+// Results of dcf_classify_pulse.
+#define DCF_PULSE_0 0
+#define DCF_PULSE_1 1
+#define DCF_PULSE_INVALID 2
+
+// The highest confidence value assigned by dcf_classify_pulse.
+#define DCF_CONFIDENCE_MAX 255
+
+// Results of dcf_classify_gap.
+#define DCF_GAP_SECOND 0
+#define DCF_GAP_MINUTE 1
+#define DCF_GAP_INVALID 2
+
+/**
+ * Resets the decision windows to their initial values and clears the
+ * histograms.
+ */
+void dcf_classifier_init();
+
+/**
+ * Classifies the duration of a pulse (positive duty cycle) as a 0 or 1 bit,
+ * and records it in the histogram.
+ *
+ * @param duration:
+ *     In Timer 1 counts.
+ * @param confidence:
+ *     The distance of the duration from the 0/1 decision threshold is
+ *     stored here; 0 means "right on the threshold", DCF_CONFIDENCE_MAX
+ *     means "at the expected length or beyond".
+ *     Invalid pulses have confidence 0.
+ * @returns
+ *     DCF_PULSE_0, DCF_PULSE_1 or DCF_PULSE_INVALID.
+ */
+uint8_t dcf_classify_pulse(uint32_t duration, uint8_t *confidence);
+
+/**
+ * Classifies the duration of a gap (negative duty cycle) as a regular second
+ * or a minute-end marker, and records it in the histogram.
+ *
+ * The gap is measured together with the pulse before it, so the window is
+ * centered on the start of the next second whether that pulse was a 0 or
+ * a 1 bit.
+ *
+ * @param duration:
+ *     In Timer 1 counts.
+ * @param pulse:
+ *     The duration of the pulse before the gap, in Timer 1 counts.
+ * @returns
+ *     DCF_GAP_SECOND, DCF_GAP_MINUTE or DCF_GAP_INVALID.
+ */
+uint8_t dcf_classify_gap(uint32_t duration, uint32_t pulse);
+
+/**
+ * Re-centers the decision windows on the recorded histograms.
+ *
+ * Each window is shifted by at most DCF_ADAPT_LIMIT from its initial
+ * position, and the 0/1 windows never overlap.
+ * Windows without enough recorded durations are left untouched.
+ *
+ * Meant to be called once per received minute.
+ */
+void dcf_classifier_adapt();
+
+#endif
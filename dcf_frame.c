@@ -0,0 +1,225 @@
+#include "dcf_frame.h"
+
+#include <stdint.h>
+
+#include <avr/pgmspace.h>
+
+/**
+ * The frame schema: the location of each digit in the frame, its weight,
+ * and the parity group that protects it.
+ */
+static const struct dcf_frame_field dcf_frame_schema[] PROGMEM = {
+	{15, 1,  1, DCF_VALUE_CALL_BIT,              DCF_GROUP_NONE},
+	{16, 1,  1, DCF_VALUE_TIMEZONE_ANNOUNCED,    DCF_GROUP_NONE},
+	{17, 1,  1, DCF_VALUE_CEST,                  DCF_GROUP_NONE},
+	{18, 1,  1, DCF_VALUE_CET,                   DCF_GROUP_NONE},
+	{19, 1,  1, DCF_VALUE_LEAP_SECOND_ANNOUNCED, DCF_GROUP_NONE},
+	{20, 1,  1, DCF_VALUE_START,                 DCF_GROUP_NONE},
+	{21, 4,  1, DCF_VALUE_MINUTE,                DCF_GROUP_MINUTE},
+	{25, 3, 10, DCF_VALUE_MINUTE,                DCF_GROUP_MINUTE},
+	{29, 4,  1, DCF_VALUE_HOUR,                  DCF_GROUP_HOUR},
+	{33, 2, 10, DCF_VALUE_HOUR,                  DCF_GROUP_HOUR},
+	{36, 4,  1, DCF_VALUE_DAY_OF_MONTH,          DCF_GROUP_DATE},
+	{40, 2, 10, DCF_VALUE_DAY_OF_MONTH,          DCF_GROUP_DATE},
+	{42, 3,  1, DCF_VALUE_DAY_OF_WEEK,           DCF_GROUP_DATE},
+	{45, 4,  1, DCF_VALUE_MONTH,                 DCF_GROUP_DATE},
+	{49, 1, 10, DCF_VALUE_MONTH,                 DCF_GROUP_DATE},
+	{50, 4,  1, DCF_VALUE_YEAR,                  DCF_GROUP_DATE},
+	{54, 4, 10, DCF_VALUE_YEAR,                  DCF_GROUP_DATE},
+};
+
+#define DCF_FRAME_SCHEMA_SIZE \
+	(sizeof(dcf_frame_schema) / sizeof(dcf_frame_schema[0]))
+
+/**
+ * The bits of each parity group, indexed by DCF_GROUP_*.
+ */
+static const uint64_t dcf_frame_groups[DCF_GROUP_COUNT] = {
+	DCF_FIELD_MINUTE, DCF_FIELD_HOUR, DCF_FIELD_DATE
+};
+
+/**
+ * The bits of each nibble in reverse order.
+ */
+static const uint8_t reversed_nibbles[16] PROGMEM = {
+	0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
+	0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf
+};
+
+/**
+ * Reverses the order of the lowest width bits of value.
+ */
+static uint8_t reverse_bits(uint8_t value, uint8_t width) {
+	uint8_t reversed = pgm_read_byte(&reversed_nibbles[value & 0x0f]) << 4 |
+	                   pgm_read_byte(&reversed_nibbles[value >> 4]);
+	return reversed >> (8 - width);
+}
+
+/**
+ * Reads the bits [lowest, lowest + width) as a binary number (bit #lowest
+ * being the least significant one).
+ *
+ * Only the (at most) two bytes that contain the bits are touched, instead
+ * of shifting all of the 64 bits.
+ */
+static uint8_t read_bits(uint64_t *bits, uint8_t lowest, uint8_t width) {
+	// AVR-GCC uses little endian, so byte #0 holds bits #0 to #7.
+	uint8_t *bytes = (uint8_t *) bits;
+	uint8_t index = lowest >> 3;
+
+	uint16_t window = bytes[index];
+	if (index < sizeof(*bits) - 1) {
+		window |= (uint16_t) bytes[index + 1] << 8;
+	}
+
+	return (window >> (lowest & 7)) & ((1 << width) - 1);
+}
+
+uint8_t dcf_frame_parity(uint64_t bits) {
+	uint8_t *bytes = (uint8_t *) &bits;
+
+	uint8_t folded = 0;
+	for (uint8_t i = 0; i < sizeof(bits); i++) {
+		folded ^= bytes[i];
+	}
+
+	folded ^= folded >> 4;
+	folded ^= folded >> 2;
+	folded ^= folded >> 1;
+
+	return folded & 1;
+}
+
+uint8_t dcf_frame_read_field(uint64_t bits, uint8_t pos, uint8_t width) {
+	// The most significant bit is the lowest one.
+	uint8_t lowest = pos + 1 - width;
+	return reverse_bits(read_bits(&bits, lowest, width), width);
+}
+
+uint64_t dcf_frame_write_field(uint64_t bits, uint8_t pos, uint8_t width,
+	uint8_t value) {
+
+	uint8_t lowest = pos + 1 - width;
+	uint64_t mask = (uint64_t) ((1 << width) - 1) << lowest;
+
+	return (bits & ~mask) |
+	       ((uint64_t) reverse_bits(value, width) << lowest);
+}
+
+uint8_t dcf_frame_read_bcd(uint64_t bits, uint8_t pos, uint8_t tens_width) {
+	uint8_t units = dcf_frame_read_field(bits, pos, 4);
+	if (units >= 10) {
+		return 0xff;
+	}
+
+	return units + 10 * dcf_frame_read_field(bits, pos - 4, tens_width);
+}
+
+uint64_t dcf_frame_write_bcd(uint64_t bits, uint8_t pos, uint8_t tens_width,
+	uint8_t value) {
+
+	bits = dcf_frame_write_field(bits, pos, 4, value % 10);
+	return dcf_frame_write_field(bits, pos - 4, tens_width, value / 10);
+}
+
+uint64_t dcf_frame_set_parity(uint64_t bits, uint64_t field) {
+	// The parity bit is the lowest bit of the field.
+	uint64_t parity_bit = field & -field;
+
+	bits &= ~parity_bit;
+	if (dcf_frame_parity(bits & field)) {
+		bits |= parity_bit;
+	}
+
+	return bits;
+}
+
+uint8_t dcf_frame_parity_ok(uint64_t bits, uint64_t field) {
+	return dcf_frame_parity(bits & field) == 0;
+}
+
+uint8_t dcf_frame_decode(uint64_t bits, uint8_t *values, uint8_t groups) {
+	uint8_t bad_groups = 0;
+	for (uint8_t group = 0; group < DCF_GROUP_COUNT; group++) {
+		if ((groups & (1 << group)) &&
+		    dcf_frame_parity(bits & dcf_frame_groups[group])) {
+			bad_groups |= 1 << group;
+		}
+	}
+
+	for (uint8_t i = 0; i < DCF_VALUE_COUNT; i++) {
+		values[i] = 0;
+	}
+
+	uint8_t result = 1;
+
+	for (uint8_t i = 0; i < DCF_FRAME_SCHEMA_SIZE; i++) {
+		struct dcf_frame_field field;
+		memcpy_P(&field, &dcf_frame_schema[i], sizeof(field));
+
+		if (field.group != DCF_GROUP_NONE &&
+		    !(groups & (1 << field.group))) {
+			continue;
+		}
+
+		// The last bit of the digit is the lowest one.
+		uint8_t lowest = DCF_FRAME_BITS - field.second - field.width;
+		uint8_t digit = reverse_bits(
+			read_bits(&bits, lowest, field.width), field.width);
+
+		if (digit >= 10) {
+			result = 0;
+		}
+		if (field.group != DCF_GROUP_NONE &&
+		    (bad_groups & (1 << field.group))) {
+			result = 0;
+		}
+
+		values[field.value] += digit * field.weight;
+	}
+
+	return result;
+}
+
+uint64_t dcf_frame_encode(struct gregorian_date_time *datetime) {
+	uint8_t values[DCF_VALUE_COUNT];
+
+	values[DCF_VALUE_CALL_BIT] = datetime->call_bit;
+	values[DCF_VALUE_TIMEZONE_ANNOUNCED] =
+		datetime->timezone_change_announced;
+	values[DCF_VALUE_CEST] = (datetime->timezone == +2);
+	values[DCF_VALUE_CET] = (datetime->timezone != +2);
+	values[DCF_VALUE_LEAP_SECOND_ANNOUNCED] =
+		datetime->time.leap_second_announced;
+	values[DCF_VALUE_START] = 1;
+	values[DCF_VALUE_MINUTE] = datetime->time.minute;
+	values[DCF_VALUE_HOUR] = datetime->time.hour;
+	values[DCF_VALUE_DAY_OF_MONTH] = datetime->date.day_of_month;
+	values[DCF_VALUE_MONTH] = datetime->date.month;
+	values[DCF_VALUE_YEAR] = datetime->date.year;
+
+	// DCF77 transmits sunday as 7.
+	values[DCF_VALUE_DAY_OF_WEEK] = datetime->date.day_of_week;
+	if (values[DCF_VALUE_DAY_OF_WEEK] == 0) {
+		values[DCF_VALUE_DAY_OF_WEEK] = 7;
+	}
+
+	uint64_t bits = 0;
+
+	for (uint8_t i = 0; i < DCF_FRAME_SCHEMA_SIZE; i++) {
+		struct dcf_frame_field field;
+		memcpy_P(&field, &dcf_frame_schema[i], sizeof(field));
+
+		uint8_t value = values[field.value];
+		uint8_t digit = (field.weight == 10) ? value / 10 : value % 10;
+
+		uint8_t pos = DCF_FRAME_BITS - 1 - field.second;
+		bits = dcf_frame_write_field(bits, pos, field.width, digit);
+	}
+
+	for (uint8_t group = 0; group < DCF_GROUP_COUNT; group++) {
+		bits = dcf_frame_set_parity(bits, dcf_frame_groups[group]);
+	}
+
+	return bits;
+}
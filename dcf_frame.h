@@ -0,0 +1,150 @@
+// Helpers for reading and writing the fields of DCF77 frames.
+//
+// Bit positions are as in dcf_poll_data: the bits are assembled by
+// left-shifting, so #0 is the last bit of the minute (the date parity),
+// and #58 is the first one.
+
+#ifndef DCF77AVR_DCF_FRAME_H_
+#define DCF77AVR_DCF_FRAME_H_
+
+#include <stdint.h>
+
+#include "gregorian_calendar.h"
+
+/**
+ * The number of bits in a minute without a leap second.
+ */
+#define DCF_FRAME_BITS 59
+
+// The parity groups (see dcf_check_range); the lowest bit of each
+// group is its parity bit.
+#define DCF_FIELD_DATE (((uint64_t) 1 << 23) - 1)
+#define DCF_FIELD_HOUR ((((uint64_t) 1 << 30) - 1) & ~DCF_FIELD_DATE)
+#define DCF_FIELD_MINUTE \
+	((((uint64_t) 1 << 38) - 1) & ~DCF_FIELD_HOUR & ~DCF_FIELD_DATE)
+
+// The parity groups, as referenced by struct dcf_frame_field.
+#define DCF_GROUP_MINUTE 0
+#define DCF_GROUP_HOUR 1
+#define DCF_GROUP_DATE 2
+#define DCF_GROUP_COUNT 3
+#define DCF_GROUP_NONE 0xff
+
+// A mask of all parity groups, for dcf_frame_decode.
+#define DCF_GROUPS_ALL ((1 << DCF_GROUP_COUNT) - 1)
+
+// The values decoded by dcf_frame_decode.
+#define DCF_VALUE_CALL_BIT 0
+#define DCF_VALUE_TIMEZONE_ANNOUNCED 1
+#define DCF_VALUE_CEST 2
+#define DCF_VALUE_CET 3
+#define DCF_VALUE_LEAP_SECOND_ANNOUNCED 4
+#define DCF_VALUE_START 5
+#define DCF_VALUE_MINUTE 6
+#define DCF_VALUE_HOUR 7
+#define DCF_VALUE_DAY_OF_MONTH 8
+#define DCF_VALUE_DAY_OF_WEEK 9
+#define DCF_VALUE_MONTH 10
+#define DCF_VALUE_YEAR 11
+#define DCF_VALUE_COUNT 12
+
+/**
+ * A single digit (or flag) of a frame, as listed in the frame schema.
+ */
+struct dcf_frame_field {
+	// The second in which the first (least significant) bit is
+	// transmitted.
+	uint8_t second;
+	// The number of bits; at most 8.
+	uint8_t width;
+	// The digit is multiplied by this, and added to the value.
+	uint8_t weight;
+	// One of DCF_VALUE_*.
+	uint8_t value;
+	// One of DCF_GROUP_*.
+	uint8_t group;
+};
+
+/**
+ * Calculates the parity over all bits of the given word.
+ */
+uint8_t dcf_frame_parity(uint64_t bits);
+
+/**
+ * Decodes all values of a frame, as described by the frame schema.
+ *
+ * Only the digits are checked: all of them must be < 10, and their parity
+ * groups must have even parity. No range checks are performed.
+ *
+ * @param values:
+ *     The values are stored here, indexed by DCF_VALUE_*.
+ *     The day of week is as transmitted (sunday == 7).
+ * @param groups:
+ *     A mask of the parity groups (1 << DCF_GROUP_*) whose digits are
+ *     decoded; the values of the other groups' digits are left at 0.
+ *     The flags are always decoded.
+ * @returns
+ *     1 on success, 0 else (the values are stored anyway).
+ */
+uint8_t dcf_frame_decode(uint64_t bits, uint8_t *values, uint8_t groups);
+
+/**
+ * Reads a binary number of the given width (at most 8); the least
+ * significant bit is at pos, the more significant bits follow at pos - 1,
+ * pos - 2, ...
+ */
+uint8_t dcf_frame_read_field(uint64_t bits, uint8_t pos, uint8_t width);
+
+/**
+ * Writes a binary number of the given width (at most 8); the inverse of
+ * dcf_frame_read_field.
+ *
+ * @returns
+ *     The modified bits.
+ */
+uint64_t dcf_frame_write_field(uint64_t bits, uint8_t pos, uint8_t width,
+	uint8_t value);
+
+/**
+ * Reads a two-digit binary-coded decimal; the units digit has 4 bits and
+ * starts at pos, the tens digit has tens_width bits and starts at pos - 4.
+ *
+ * @returns
+ *     The value, or 0xff if the units digit is >= 10.
+ */
+uint8_t dcf_frame_read_bcd(uint64_t bits, uint8_t pos, uint8_t tens_width);
+
+/**
+ * Writes a two-digit binary-coded decimal; the inverse of
+ * dcf_frame_read_bcd.
+ *
+ * @returns
+ *     The modified bits.
+ */
+uint64_t dcf_frame_write_bcd(uint64_t bits, uint8_t pos, uint8_t tens_width,
+	uint8_t value);
+
+/**
+ * Sets the parity bit of the given parity group (its lowest bit) such that
+ * the group has even parity.
+ *
+ * @returns
+ *     The modified bits.
+ */
+uint64_t dcf_frame_set_parity(uint64_t bits, uint64_t field);
+
+/**
+ * Checks whether the given parity group has even parity.
+ */
+uint8_t dcf_frame_parity_ok(uint64_t bits, uint64_t field);
+
+/**
+ * Encodes the given local date-time as the 59 bits of a frame, as
+ * dcf_decode_bits would decode it.
+ *
+ * The bits that are not used by dcf_decode_bits (#44 to #58) are 0.
+ * The date must have been validated (day_of_week is 0-6, sunday == 0).
+ */
+uint64_t dcf_frame_encode(struct gregorian_date_time *datetime);
+
+#endif
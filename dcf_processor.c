@@ -1,198 +1,292 @@
 #include "dcf_processor.h"
 
-#include <util/atomic.h>
-
 #include "dbg.h"
+#include "dcf_accumulator.h"
+#include "dcf_classifier.h"
+#include "dcf_frame.h"
 #include "gregorian_calendar.h"
+#include "monotime.h"
+#include "phase_tracker.h"
 #include "util.h"
 
+/**
+ * Returns a mask of the bits [start, end).
+ */
+uint64_t bit_range(uint8_t start, uint8_t end) {
+	return (((uint64_t) 1 << end) - 1) & ~(((uint64_t) 1 << start) - 1);
+}
+
 /**
  * Finds the index of the highest bit that is actually '1'.
+ *
+ * Takes the same number of steps for every value: a binary search for the
+ * most significant non-zero byte, followed by one within that byte.
  */
 uint8_t find_index_of_highest_bit(uint64_t *val) {
-	// Check val byte-by-byte, starting with the most significant one.
 	// AVR-GCC uses little endian, so that's byte #sizeof(*val) - 1.
-	// This would not be very beautiful as a for loop.
-	uint8_t byteindex = sizeof(*val);
-	while (1) {
-		byteindex -= 1;
-
-		uint8_t current_byte = ((uint8_t *) val)[byteindex];
-		if (current_byte == 0) {
-			if (byteindex == 0) {
-				// val has no bits set... unfortunately (?) C
-				// can't simply 'raise ValueError()'.
-
-				// *shrugs*
-				return 0;
-			}
+	uint8_t *bytes = (uint8_t *) val;
 
-			continue;
-		}
-
-		// We've found a byte that has a bit set.
-		uint8_t result = byteindex * 8;
+	uint8_t byteindex = 0;
+	if (bytes[7] | bytes[6] | bytes[5] | bytes[4]) {
+		byteindex = 4;
+	}
+	if (bytes[byteindex + 3] | bytes[byteindex + 2]) {
+		byteindex += 2;
+	}
+	if (bytes[byteindex + 1]) {
+		byteindex += 1;
+	}
 
-		// Now to find out which one...
-		while (1) {
-			current_byte >>= 1;
+	// If val has no bits set, this ends up as 0... *shrugs*
+	uint8_t current_byte = bytes[byteindex];
+	uint8_t result = byteindex * 8;
 
-			if (current_byte) {
-				result++;
-			} else {
-				return result;
-			}
-		}
+	if (current_byte & 0xf0) {
+		current_byte >>= 4;
+		result += 4;
+	}
+	if (current_byte & 0x0c) {
+		current_byte >>= 2;
+		result += 2;
+	}
+	if (current_byte & 0x02) {
+		result += 1;
 	}
+
+	return result;
 }
 
 /**
  * Calculates the parity of a certain range of bits in the given word.
  */
 uint8_t parity(uint64_t *word, uint8_t start, uint8_t end) {
-	uint8_t result = 0;
-
-	uint64_t mask = (1 << start);
-	while (start != end) {
-		if (*word & mask) {
-			result = !result;
-		}
-
-		start += 1;
-		mask <<= 1;
-	}
-
-	return result;
+	return dcf_frame_parity(*word & bit_range(start, end));
 }
 
 /**
- * Verifies the basic parities in the given minute bits.
- * Invoked by dcf_try_process.
+ * Bits with a confidence below this value may be flipped to repair a parity
+ * group.
+ */
+#define DCF_REPAIR_MAX_CONFIDENCE (DCF_CONFIDENCE_MAX / 4)
+
+/**
+ * If the parity over the bits [start, end) is odd, flips the least
+ * confident bit in that range, provided that its confidence is low enough.
  *
  * @returns
- *     1 on success, 0 on failure.
+ *     1 if the parity is (now) even, 0 else.
  */
-uint8_t dcf_verify_parities(uint64_t *minute_bits) {
-	if (BIT(*minute_bits, 41) == BIT(*minute_bits, 40)) {
-		// The CET and CEST bits always need to have opposite values.
-		puts("CET and CEST bits don't have opposite values.\n");
-		return 0;
-	}
+uint8_t dcf_repair_parity(uint64_t *minute_bits, uint8_t *confidence,
+	uint8_t start, uint8_t end) {
 
-	if (BIT(*minute_bits, 38) != 1) {
-		// The start-of-encoded-time bit must be always 1.
-		puts("Start-of-encoded-time bit is not 1.\n");
-		return 0;
+	if (parity(minute_bits, start, end) == 0) {
+		return 1;
 	}
 
-	if (parity(minute_bits, 30, 38) != 0) {
-		// Odd parity over minutes
-		puts("Minute bits (30 to 37) have odd parity.\n");
-		return 0;
+	uint8_t weakest = start;
+	for (uint8_t pos = start + 1; pos < end; pos++) {
+		if (confidence[pos] < confidence[weakest]) {
+			weakest = pos;
+		}
 	}
 
-	if (parity(minute_bits, 23, 30) != 0) {
-		// Odd parity over hours
-		puts("Hour bits (23 to 29) have odd parity.\n");
+	if (confidence[weakest] >= DCF_REPAIR_MAX_CONFIDENCE) {
 		return 0;
 	}
 
-	if (parity(minute_bits, 0, 23) != 0) {
-		// Odd parity over date
-		puts("Date bits (0 to 22) have odd parity.\n");
-		return 0;
-	}
+	printf("Flipping bit %hd (confidence %hd) to repair parity.\n",
+		weakest, confidence[weakest]);
+	*minute_bits ^= ((uint64_t) 1 << weakest);
 
-	// no errors have been found.
 	return 1;
 }
 
 /**
- * Reads a single bit of data.
+ * Counts the bits that are set in a certain range of bits in the given word.
  */
-inline uint8_t read_bcd_1(uint64_t *data, uint8_t pos) {
-	return BIT(*data, pos);
+uint8_t count_bits(uint64_t *word, uint8_t start, uint8_t end) {
+	uint8_t result = 0;
+
+	for (uint8_t pos = start; pos < end; pos++) {
+		result += BIT(*word, pos);
+	}
+
+	return result;
 }
 
 /**
- * Reads a single 2-bit binary-coded digit from data,
- * from bits #pos and #pos-1.
+ * Fills an erased bit from the parity over [start, end), provided that it
+ * is the only erasure in that range.
  *
- * In case of an error, sets error=1.
+ * @returns
+ *     1 if there are no erasures left in the range, 0 else.
  */
-inline uint8_t read_bcd_2(uint64_t *data, uint8_t pos) {
-	return
-		BIT(*data, pos - 0) * 1 +
-		BIT(*data, pos - 1) * 2;
+uint8_t dcf_fill_parity_erasure(uint64_t *minute_bits, uint64_t *erasures,
+	uint8_t start, uint8_t end) {
+
+	uint8_t count = count_bits(erasures, start, end);
+	if (count == 0) {
+		return 1;
+	}
+
+	if (count > 1) {
+		printf("%hd erasures in bits %hd to %hd.\n", count, start,
+			end - 1);
+		return 0;
+	}
+
+	// Erased bits are 0, so if the parity is odd, the bit must be 1.
+	if (parity(minute_bits, start, end)) {
+		*minute_bits |= *erasures & bit_range(start, end);
+	}
+
+	*erasures &= ~bit_range(start, end);
+
+	return 1;
 }
 
+// The ranges of bits that are checked independently of each other: the
+// parity groups (DCF_GROUP_*), and the flags between the minute and the
+// weather bits.
+#define DCF_RANGE_FLAGS DCF_GROUP_COUNT
+#define DCF_RANGE_COUNT (DCF_GROUP_COUNT + 1)
+
+static const uint8_t dcf_range_start[DCF_RANGE_COUNT] = {30, 23, 0, 38};
+static const uint8_t dcf_range_end[DCF_RANGE_COUNT] = {38, 30, 23, 44};
+
 /**
- * Reads a single 3-bit binary-coded digit from data,
- * from bits #pos, #pos-1 and #pos-2.
+ * Restores the erased flags, and checks the fixed bits among them.
+ * Erased announcement bits and call bits are assumed to be 0.
+ *
+ * @returns
+ *     1 if the flags are valid, 0 else.
  */
-inline uint8_t read_bcd_3(uint64_t *data, uint8_t pos) {
-	return
-		BIT(*data, pos - 0) * 1 +
-		BIT(*data, pos - 1) * 2 +
-		BIT(*data, pos - 2) * 4;
+uint8_t dcf_check_flags(uint64_t *minute_bits, uint64_t erasures) {
+	if (BIT(erasures, 38)) {
+		// The start-of-encoded-time bit is always 1.
+		*minute_bits |= (uint64_t) 1 << 38;
+	}
+
+	if (BIT(erasures, 41) && BIT(erasures, 40)) {
+		puts("Both CET and CEST bits are erased.\n");
+		return 0;
+	}
+	if (BIT(erasures, 41) && !BIT(*minute_bits, 40)) {
+		*minute_bits |= (uint64_t) 1 << 41;
+	}
+	if (BIT(erasures, 40) && !BIT(*minute_bits, 41)) {
+		*minute_bits |= (uint64_t) 1 << 40;
+	}
+
+	if (BIT(*minute_bits, 41) == BIT(*minute_bits, 40)) {
+		// The CET and CEST bits always need to have opposite values.
+		puts("CET and CEST bits don't have opposite values.\n");
+		return 0;
+	}
+
+	if (BIT(*minute_bits, 38) != 1) {
+		// The start-of-encoded-time bit must be always 1.
+		puts("Start-of-encoded-time bit is not 1.\n");
+		return 0;
+	}
+
+	return 1;
 }
 
 /**
- * Reads a single 4-bit binary-coded digit from data,
- * from bits #pos, #pos-1, #pos-2 and #pos-3.
+ * Checks one range of a frame (one of the DCF_RANGE_* values):
+ * Erased bits are filled from the bits around them (fixed bits are
+ * restored, the CET/CEST bits are restored from each other, and a single
+ * erasure in a parity group is restored from the parity), then a parity
+ * error is repaired by flipping the least confident bit, if possible.
  *
- * If the digit is >= 10, sets *error=1 and returns 0.
+ * @param bits
+ *     The repaired bits of the range are stored here; all other bits are
+ *     0.
+ * @returns
+ *     1 if the range is valid, 0 else.
  */
-inline uint8_t read_bcd_4(uint64_t *data, uint8_t pos, uint8_t *error) {
-	uint8_t result =
-		BIT(*data, pos - 0) * 1 +
-		BIT(*data, pos - 1) * 2 +
-		BIT(*data, pos - 2) * 4 +
-		BIT(*data, pos - 3) * 8;
-
-	if (result >= 10) {
-		*error = 1;
+uint8_t dcf_check_range(struct dcf_frame *frame, uint8_t range,
+	uint64_t *bits) {
+
+	uint8_t start = dcf_range_start[range];
+	uint8_t end = dcf_range_end[range];
+
+	uint64_t mask = bit_range(start, end);
+	*bits = frame->bits & mask;
+	uint64_t erasures = frame->erasures & mask;
+
+	if (range == DCF_RANGE_FLAGS) {
+		return dcf_check_flags(bits, erasures);
+	}
+
+	if (!dcf_fill_parity_erasure(bits, &erasures, start, end) ||
+	    !dcf_repair_parity(bits, frame->confidence, start, end)) {
+		printf("Bits %hd to %hd are corrupted.\n", start, end - 1);
 		return 0;
-	} else {
-		return result;
 	}
+
+	return 1;
 }
 
+uint16_t dcf_frames_clean = 0;
+uint16_t dcf_frames_corrected = 0;
+uint16_t dcf_frames_realigned = 0;
+
+// Set once current_date_time has been set from a received frame.
+static uint8_t clock_is_set = 0;
+
+// The date bits (0 to 22) of the last frame whose date has been validated,
+// and the validated date.
+static uint8_t date_cache_valid = 0;
+static uint32_t date_cache_bits;
+static struct gregorian_date date_cache;
+
 /**
- * Called by dcf_process; one instance of dcf_process might call this multiple
- * times, with different parameters.
+ * Decodes and validates the bits of a frame that have been checked by
+ * dcf_check_range, without touching the clock.
  *
  * @param minute_bits
- *     It is guarnateed that minute_bits has at least 44 bits. A possible leap
- *     second bit has been removed from the end.
- * @param timestamp_monotime
- *     As for dcf_process.
+ *     The bits 0 to 43 of the frame; a possible leap second bit has been
+ *     removed from the end.
  * @param has_leap_second
  *     True if a leap_second bit was removed from the end.
+ * @param result
+ *     On success, the date-time at the minute-end marker that has ended
+ *     the frame is stored here (the epoch is not set).
  *
  * @returns
  *     On failure, 0; on success, 1.
  */
-uint8_t dcf_try_process(uint64_t *minute_bits, uint32_t *timestamp_monotime,
-	uint8_t has_leap_second) {
+uint8_t dcf_decode_bits(uint64_t *minute_bits, uint8_t has_leap_second,
+	struct gregorian_date_time *result) {
 
-	// verify basic parities
-	if (dcf_verify_parities(minute_bits) == 0) {
-		puts("Parity verification failed.\n");
-		return 0;
+	// The date only changes once a day; if its bits are the same as
+	// last time, so is the result.
+	uint32_t date_bits = (uint32_t) (*minute_bits & DCF_FIELD_DATE);
+	uint8_t date_cached = date_cache_valid && (date_bits == date_cache_bits);
+
+	uint8_t groups = DCF_GROUPS_ALL;
+	if (date_cached) {
+		groups &= ~(1 << DCF_GROUP_DATE);
 	}
 
-	uint8_t error = 0;
+	// Decode the fields as described by the frame schema.
+	uint8_t values[DCF_VALUE_COUNT];
+	uint8_t valid;
+	dbg_benchmark("Fields decoded",
+		valid = dcf_frame_decode(*minute_bits, values, groups));
 
 	struct gregorian_date_time datetime;
 
-	datetime.call_bit = BIT(*minute_bits, 43);
+	datetime.call_bit = values[DCF_VALUE_CALL_BIT];
 	if (datetime.call_bit) {
 		puts("Warning: Abnormal transmitter operation!\n");
 	}
 
-	datetime.timezone_change_announced = BIT(*minute_bits, 42);
-	if (BIT(*minute_bits, 40)) {
+	datetime.timezone_change_announced =
+		values[DCF_VALUE_TIMEZONE_ANNOUNCED];
+	if (values[DCF_VALUE_CET]) {
 		// CET
 		datetime.timezone = +1;
 	} else {
@@ -200,26 +294,21 @@ uint8_t dcf_try_process(uint64_t *minute_bits, uint32_t *timestamp_monotime,
 		datetime.timezone = +2;
 	}
 
-	datetime.time.leap_second_announced = BIT(*minute_bits, 39);
+	datetime.time.leap_second_announced =
+		values[DCF_VALUE_LEAP_SECOND_ANNOUNCED];
 
 	datetime.time.second =       0;
+	datetime.time.minute =       values[DCF_VALUE_MINUTE];
+	datetime.time.hour =         values[DCF_VALUE_HOUR];
 
-	datetime.time.minute =       1 * read_bcd_4(minute_bits, 37, &error) +
-	                            10 * read_bcd_3(minute_bits, 33);
-
-	datetime.time.hour =         1 * read_bcd_4(minute_bits, 29, &error) +
-	                            10 * read_bcd_2(minute_bits, 25);
-
-	datetime.date.day_of_month = 1 * read_bcd_4(minute_bits, 22, &error) +
-	                            10 * read_bcd_2(minute_bits, 18);
-
-	datetime.date.day_of_week =  1 * read_bcd_3(minute_bits, 16);
-
-	datetime.date.month =        1 * read_bcd_4(minute_bits, 13, &error) +
-	                            10 * read_bcd_1(minute_bits,  9);
-
-	datetime.date.year =         1 * read_bcd_4(minute_bits,  8, &error) +
-	                            10 * read_bcd_4(minute_bits,  4, &error);
+	if (date_cached) {
+		datetime.date = date_cache;
+	} else {
+		datetime.date.day_of_month = values[DCF_VALUE_DAY_OF_MONTH];
+		datetime.date.day_of_week =  values[DCF_VALUE_DAY_OF_WEEK];
+		datetime.date.month =        values[DCF_VALUE_MONTH];
+		datetime.date.year =         values[DCF_VALUE_YEAR];
+	}
 
 	printf("%hd %02hd-%02hd-%02hd %02hd:%02hd\n",
 		datetime.date.day_of_week,
@@ -230,7 +319,7 @@ uint8_t dcf_try_process(uint64_t *minute_bits, uint32_t *timestamp_monotime,
 		datetime.time.minute);
 
 
-	if (error) {
+	if (!valid) {
 		puts("One of the binary-coded digits was >= 10.\n");
 		return 0;
 	}
@@ -239,8 +328,14 @@ uint8_t dcf_try_process(uint64_t *minute_bits, uint32_t *timestamp_monotime,
 		return 0;
 	}
 
-	if (!gregorian_date_validate(&datetime.date)) {
-		return 0;
+	if (!date_cached) {
+		if (!gregorian_date_validate(&datetime.date)) {
+			return 0;
+		}
+
+		date_cache = datetime.date;
+		date_cache_bits = date_bits;
+		date_cache_valid = 1;
 	}
 
 	// Check whether the leap second information is consistent.
@@ -276,27 +371,396 @@ uint8_t dcf_try_process(uint64_t *minute_bits, uint32_t *timestamp_monotime,
 	gregorian_date_time_increment(&datetime);
 
 	// Finally, calculate the UNIX time.
-	gregorian_date_time_calculate_unix_time(&datetime);
-	printf("Unix time: %ld.\n", datetime.unix_time);
+	dbg_benchmark("UNIX time calculated",
+		gregorian_date_time_calculate_unix_time(&datetime));
+	printf("Unix time: %lu.\n", datetime.unix_time);
+
+	*result = datetime;
+
+	return 1;
+}
+
+/**
+ * Decodes and validates a frame, without touching the clock.
+ * Called by dcf_process_partial.
+ *
+ * @param frame
+ *     It is guarnateed that frame has at least 44 bits, aligned as in a
+ *     regular minute.
+ * @param datetime
+ *     As in dcf_decode_bits.
+ *
+ * @returns
+ *     On failure, 0; on success, 1.
+ */
+uint8_t dcf_try_decode(struct dcf_frame *frame,
+	struct gregorian_date_time *result) {
+
+	uint64_t bits = 0;
+	for (uint8_t range = 0; range < DCF_RANGE_COUNT; range++) {
+		uint64_t range_bits;
+		if (!dcf_check_range(frame, range, &range_bits)) {
+			return 0;
+		}
+		bits |= range_bits;
+	}
+
+	return dcf_decode_bits(&bits, 0, result);
+}
+
+/**
+ * Sets the clock to a decoded date-time.
+ *
+ * @param timestamp_monotime
+ *     The monotime of the minute-end marker at which datetime starts.
+ */
+void dcf_commit(struct gregorian_date_time *datetime,
+	uint32_t timestamp_monotime) {
 
 	// Time to update the clock accordingly.
-	datetime.epoch_monotime = (int64_t) *timestamp_monotime -
-	                          (int64_t) (datetime.unix_time << 8);
+	datetime->epoch_monotime = timestamp_monotime -
+	                           (datetime->unix_time << 8);
 
-	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-		current_date_time = datetime;
+	// The minute-end marker is only one of 60 second starts; keep the
+	// phase that has been tracked from all of them.
+	datetime->epoch_monotime = phase_tracker_align(
+		datetime->epoch_monotime);
+
+	gregorian_calendar_set(datetime);
+
+	clock_is_set = 1;
+}
+
+/**
+ * The bits that are compared with the prediction: everything from the
+ * date parity up to the CEST bit, except for the leap second announcement.
+ * The announcement and call bits can't be predicted.
+ */
+#define DCF_PREDICTION_MASK (bit_range(0, 42) & ~((uint64_t) 1 << 39))
+
+// The bits that can't be predicted: the announcement and call bits.
+#define DCF_UNPREDICTABLE_MASK (bit_range(38, 44) & ~DCF_PREDICTION_MASK)
+
+/**
+ * Predicts the bits of the frame that is ended by a minute-end marker at
+ * the given time, from the clock.
+ *
+ * This is only possible if the clock has been set, the marker coincides
+ * with a minute start of the clock, and the clock is in the minute that
+ * the frame describes or in the one after that.
+ * In the latter case, the first minute of the hour is not predicted, since
+ * the one before it might belong to a different time zone (or day).
+ *
+ * @param predicted:
+ *     The 59 predicted bits are stored here; the bits that can't be
+ *     predicted are 0.
+ * @returns
+ *     1 if a prediction was made, 0 else.
+ */
+uint8_t dcf_predict_bits(uint32_t timestamp_monotime, uint64_t *predicted) {
+	if (!clock_is_set) {
+		return 0;
 	}
 
+	struct gregorian_date_time datetime = *gregorian_calendar_now();
+
+	// The unix time at the minute-end marker, according to the clock, in
+	// 1/256ths of a second (modulo 2^32, like all monotimes).
+	uint32_t marker = timestamp_monotime - datetime.epoch_monotime;
+	int8_t phase_error = (int8_t) (uint8_t) marker;
+	if (phase_error > PHASE_TRACKER_MAX_ERROR ||
+	    phase_error < -PHASE_TRACKER_MAX_ERROR) {
+		puts("Clock is out of phase; can't predict.\n");
+		return 0;
+	}
+
+	// The frame describes the minute before the marker (see
+	// dcf_try_decode); how far is datetime's minute from that one?
+	// The difference is small, so it is not affected by the wrap-around.
+	uint32_t minute_end = datetime.unix_time - datetime.time.second + 60;
+	int32_t offset = (int32_t) ((minute_end << 8) - (marker - phase_error));
+	if (offset == (int32_t) 60 << 8) {
+		if (datetime.time.minute == 0) {
+			return 0;
+		}
+		datetime.time.minute -= 1;
+	} else if (offset != 0) {
+		return 0;
+	}
+
+	datetime.call_bit = 0;
+	datetime.timezone_change_announced = 0;
+	datetime.time.leap_second_announced = 0;
+	*predicted = dcf_frame_encode(&datetime);
+
 	return 1;
 }
 
-uint8_t dcf_process(uint64_t *minute_bits, uint32_t *timestamp_monotime) {
-	puts("Decoding new word: ");
-	print_binary_64(stdout, *minute_bits);
-	putc('\n', stdout);
+/**
+ * Fills in a frame with the given predicted bits, at full confidence.
+ */
+void dcf_fill_predicted_frame(struct dcf_frame *frame, uint64_t predicted,
+	uint32_t timestamp_monotime) {
+
+	frame->bits = predicted | ((uint64_t) 1 << DCF_FRAME_BITS);
+	frame->erasures = 0;
+	frame->timestamp_monotime = timestamp_monotime;
+	for (uint8_t i = 0; i < DCF_FRAME_MAX_BITS; i++) {
+		frame->confidence[i] = DCF_CONFIDENCE_MAX;
+	}
+}
+
+/**
+ * Received frames that differ from the prediction in at most this many bits
+ * (not counting erasures) are replaced by the prediction.
+ */
+#define DCF_PREDICTION_MAX_DISTANCE 3
+
+/**
+ * At least this many of the bits in DCF_PREDICTION_MASK must have been
+ * received (not erased), so that faded-out frames aren't taken for
+ * confirmations of the clock.
+ */
+#define DCF_PREDICTION_MIN_BITS 24
+
+/**
+ * Counts the bits in the given parity group where the frame differs from
+ * the prediction.
+ *
+ * @returns
+ *     1 if the differences can be explained by bit errors, i.e. if there
+ *     are none, or if the frame has odd parity in that group; 0 else.
+ */
+uint8_t dcf_prediction_parity_allows(uint64_t *differences, uint8_t start,
+	uint8_t end) {
+
+	uint8_t count = count_bits(differences, start, end);
+	return count == 0 || (count & 1);
+}
+
+/**
+ * Compares the received frame with the prediction, and decides whether the
+ * frame is a corrupted copy of the prediction.
+ *
+ * @returns
+ *     1 if the prediction should be used instead of the frame, 0 else.
+ */
+uint8_t dcf_prediction_matches(struct dcf_frame *frame, uint64_t predicted) {
+	uint64_t received = DCF_PREDICTION_MASK & ~frame->erasures;
+	uint64_t differences = (frame->bits ^ predicted) & received;
+
+	uint8_t received_count = count_bits(&received, 0, DCF_FRAME_BITS);
+	uint8_t distance = count_bits(&differences, 0, DCF_FRAME_BITS);
+
+	printf("Frame differs from the prediction in %hd of %hd bits.\n",
+		distance, received_count);
+
+	if (received_count < DCF_PREDICTION_MIN_BITS ||
+	    distance > DCF_PREDICTION_MAX_DISTANCE) {
+		return 0;
+	}
+
+	// Differences in a group with even parity, or in both CET and CEST
+	// bits, look like an actual change, not like bit errors; the clock
+	// might be wrong.
+	return dcf_prediction_parity_allows(&differences, 30, 38) &&
+	       dcf_prediction_parity_allows(&differences, 23, 30) &&
+	       dcf_prediction_parity_allows(&differences, 0, 23) &&
+	       !(BIT(differences, 40) && BIT(differences, 41));
+}
+
+// The alignments of the received bits that dcf_process_frame considers.
+// A regular minute, as received.
+#define DCF_ALIGN_REGULAR 0
+// A minute with a leap second; the last bit is removed.
+#define DCF_ALIGN_LEAP 1
+// A second has not been recorded; an erased bit is inserted.
+#define DCF_ALIGN_MISSING 2
+// A second has been recorded twice (or out of thin air); a bit is removed.
+#define DCF_ALIGN_EXTRA 3
+
+/**
+ * The result of dcf_check_range for one range of the frame.
+ */
+struct dcf_range_check {
+	// 0: not checked yet; 1: valid; 2: invalid.
+	uint8_t state;
+	uint64_t bits;
+};
+
+/**
+ * The state of dcf_process_frame's search for the alignment of a frame.
+ * All alignments are evaluated on the same state, so that nothing is
+ * checked or decoded twice.
+ */
+struct dcf_alignment_search {
+	struct dcf_frame *received;
+
+	// The range checks for each shift (-1, 0, +1) of the whole frame;
+	// a range that lies entirely before or after the position of a bit
+	// slip is shared by all alignments that shift it alike.
+	struct dcf_range_check checks[3][DCF_RANGE_COUNT];
+
+	// The bits that have been decoded last, and the result; alignments
+	// that end up with the same bits (e.g. a bit slip anywhere within a
+	// run of equal bits) are not decoded again.
+	uint8_t decoded;
+	uint64_t decoded_bits;
+	uint8_t decoded_leap_second;
+	uint8_t decoded_valid;
+	struct gregorian_date_time decoded_datetime;
+};
+
+/**
+ * Builds the frame for an alignment.
+ *
+ * @param shift
+ *     -1 to remove the bit at position from the received frame, +1 to
+ *     insert an erased bit there, 0 to keep the frame as it is.
+ */
+void dcf_align(struct dcf_frame *received, int8_t shift, uint8_t position,
+	struct dcf_frame *aligned) {
+
+	uint64_t kept = bit_range(0, position);
+
+	aligned->timestamp_monotime = received->timestamp_monotime;
+
+	if (shift < 0) {
+		aligned->bits = (received->bits & kept) |
+		                ((received->bits >> 1) & ~kept);
+		aligned->erasures = (received->erasures & kept) |
+		                    ((received->erasures >> 1) & ~kept);
+	} else if (shift > 0) {
+		uint64_t moved = ~bit_range(0, position + 1);
+		aligned->bits = (received->bits & kept) |
+		                ((received->bits << 1) & moved);
+		aligned->erasures = (received->erasures & kept) |
+		                    ((received->erasures << 1) & moved) |
+		                    ((uint64_t) 1 << position);
+	} else {
+		aligned->bits = received->bits;
+		aligned->erasures = received->erasures;
+	}
+
+	for (uint8_t i = 0; i < DCF_FRAME_MAX_BITS; i++) {
+		uint8_t source = i;
+		if (shift != 0 && i >= position) {
+			source = i - shift;
+		}
+
+		if ((shift > 0 && i == position) || source >= DCF_FRAME_MAX_BITS) {
+			aligned->confidence[i] = 0;
+		} else {
+			aligned->confidence[i] = received->confidence[source];
+		}
+	}
+}
+
+/**
+ * Returns the shared check of a range for the given alignment, or 0 if
+ * the range contains the bit slip.
+ */
+struct dcf_range_check *dcf_shared_check(struct dcf_alignment_search *search,
+	int8_t shift, uint8_t position, uint8_t range) {
+
+	if (shift == 0 || dcf_range_end[range] <= position) {
+		return &search->checks[1][range];
+	}
+
+	// Removing a bit shifts all bits from its position on; inserting one
+	// shifts all bits after it.
+	uint8_t first_shifted = (shift < 0) ? position : position + 1;
+	if (dcf_range_start[range] >= first_shifted) {
+		return &search->checks[shift + 1][range];
+	}
+
+	return 0;
+}
+
+/**
+ * Checks and decodes the received frame with the given alignment.
+ *
+ * @param bits
+ *     On success, the checked bits (0 to 43) are stored here.
+ * @param datetime
+ *     On success, the result is stored here (as in dcf_decode_bits).
+ * @returns
+ *     On failure, 0; on success, 1.
+ */
+uint8_t dcf_try_alignment(struct dcf_alignment_search *search, uint8_t type,
+	uint8_t position, uint64_t *bits, struct gregorian_date_time *datetime) {
+
+	int8_t shift = 0;
+	if (type == DCF_ALIGN_MISSING) {
+		shift = 1;
+	} else if (type == DCF_ALIGN_LEAP || type == DCF_ALIGN_EXTRA) {
+		shift = -1;
+	}
+
+	struct dcf_frame aligned;
+	dcf_align(search->received, shift, position, &aligned);
+
+	*bits = 0;
+	for (uint8_t range = 0; range < DCF_RANGE_COUNT; range++) {
+		struct dcf_range_check *check = dcf_shared_check(search, shift,
+			position, range);
+
+		uint64_t range_bits;
+		uint8_t valid;
+		if (check && check->state) {
+			valid = (check->state == 1);
+			range_bits = check->bits;
+		} else {
+			valid = dcf_check_range(&aligned, range, &range_bits);
+			if (check) {
+				check->state = valid ? 1 : 2;
+				check->bits = range_bits;
+			}
+		}
+
+		if (!valid) {
+			return 0;
+		}
+		*bits |= range_bits;
+	}
+
+	uint8_t has_leap_second = (type == DCF_ALIGN_LEAP);
+	if (!search->decoded || *bits != search->decoded_bits ||
+	    has_leap_second != search->decoded_leap_second) {
+
+		search->decoded = 1;
+		search->decoded_bits = *bits;
+		search->decoded_leap_second = has_leap_second;
+		search->decoded_valid = dcf_decode_bits(bits, has_leap_second,
+			&search->decoded_datetime);
+	}
+
+	*datetime = search->decoded_datetime;
+	return search->decoded_valid;
+}
+
+/**
+ * Called by dcf_process, for the received frame and for the frames that
+ * replace it.
+ *
+ * Frames are tried as a regular minute, and as a minute with a leap
+ * second. If neither works, and the frame has one bit too few or too many,
+ * every position of the missing or extra second is tried (a frame with
+ * one bit too few is never taken as it is); the result is
+ * only accepted if all valid positions agree on the time (and, if there is
+ * a prediction, match it).
+ *
+ * @param predicted
+ *     The bits predicted from the clock for the minute that has just
+ *     ended (see dcf_predict_bits), or 0 if there is no prediction.
+ * @returns
+ *     On failure, 0; on success, 1.
+ */
+uint8_t dcf_process_frame(struct dcf_frame *frame, uint64_t *predicted) {
+	dbg_print_binary_64("Decoding new word: ", frame->bits);
 
 	// Count the number of bits.
-	uint8_t bit_count = find_index_of_highest_bit(minute_bits);
+	uint8_t bit_count = find_index_of_highest_bit(&frame->bits);
 
 	// We only need 44 bits; the first 14 bits contain encrypted garbage.
 	if (bit_count < 44) {
@@ -304,41 +768,312 @@ uint8_t dcf_process(uint64_t *minute_bits, uint32_t *timestamp_monotime) {
 		return 0;
 	}
 
-	if (bit_count < 60) {
-		// Try to verify this second as a regular second.
-		if (dcf_try_process(minute_bits, timestamp_monotime, 0)) {
-			return 1;
+	struct dcf_alignment_search search;
+	search.received = frame;
+	search.decoded = 0;
+	for (uint8_t shift = 0; shift < 3; shift++) {
+		for (uint8_t range = 0; range < DCF_RANGE_COUNT; range++) {
+			search.checks[shift][range].state = 0;
 		}
+	}
 
-		// The processing failed, but maybe that's because it's a
-		// minute with a leap second.
+	uint64_t bits;
+	struct gregorian_date_time datetime;
 
-		puts("Not valid as a regular minute.\n"
-		     "Attempting to parse it as a minute containing a leap "
-		             "second...\n");
+	// A frame with one bit too few has certainly lost a second; it's only
+	// decoded as it is below, as one of the positions of the bit slip.
+	if (bit_count <= DCF_FRAME_BITS && bit_count != DCF_FRAME_BITS - 1 &&
+	    dcf_try_alignment(&search, DCF_ALIGN_REGULAR, 0, &bits,
+	                      &datetime)) {
 
-		if (bit_count < 45) {
-			// But we have too little information to check if it
-			// actually is.
-			puts("Bit count is only 44.\n");
-			return 0;
+		dcf_commit(&datetime, frame->timestamp_monotime);
+		return 1;
+	}
+
+	// Minutes containing a leap second end in a 0; with only 44 bits, we
+	// have too little information to check that.
+	if (bit_count >= 45 && bit_count <= DCF_FRAME_BITS + 1 &&
+	    BIT(frame->bits, 0) == 0) {
+
+		puts("Attempting to parse it as a minute containing a leap "
+		     "second...\n");
+
+		if (dcf_try_alignment(&search, DCF_ALIGN_LEAP, 0, &bits,
+		                      &datetime)) {
+
+			dcf_commit(&datetime, frame->timestamp_monotime);
+			return 1;
 		}
+	}
 
-		// Fall through to below.
+	// One second too few or too many: try each position of the bit slip
+	// in the bits that we actually use; any slip in the bits from 44 on
+	// is the same as one at 44.
+	uint8_t type;
+	if (bit_count == DCF_FRAME_BITS - 1) {
+		type = DCF_ALIGN_MISSING;
+	} else if (bit_count == DCF_FRAME_BITS + 1) {
+		type = DCF_ALIGN_EXTRA;
 	} else {
-		puts("Minute has 60 bits; must contain a leap second.\n");
-		// This is a minute with a leap second... or at least it
-		// claims to be. Fall through to below.
+		return 0;
 	}
 
-	if (BIT(*minute_bits, 0) != 0) {
-		// Minutes containing a leap second end in a 0. Pretender.
-		puts("Cannot be a leap second: Doesn't end in a 0.\n");
+	puts("Attempting to realign the bits...\n");
+
+	uint8_t found = 0;
+	uint8_t ambiguous = 0;
+	uint8_t found_position = 0;
+
+	for (uint8_t position = 0; position <= 44; position++) {
+		struct gregorian_date_time candidate;
+		if (!dcf_try_alignment(&search, type, position, &bits,
+		                       &candidate)) {
+			continue;
+		}
+
+		if (predicted &&
+		    ((bits ^ *predicted) & DCF_PREDICTION_MASK) != 0) {
+			printf("Slip at bit %hd doesn't match the prediction.\n",
+				position);
+			continue;
+		}
+
+		if (found && (candidate.unix_time != datetime.unix_time ||
+		              candidate.unix_era != datetime.unix_era)) {
+			ambiguous = 1;
+		}
+
+		datetime = candidate;
+		found = 1;
+		found_position = position;
+	}
+
+	if (!found) {
+		return 0;
+	}
+
+	if (ambiguous) {
+		puts("Bit slip positions disagree on the time.\n");
 		return 0;
 	}
 
-	// Remove the last bit, and try to process it... though I still can't
-	// believe that I've actually encountered a leap second here...
-	*minute_bits >>= 1;
-	return dcf_try_process(minute_bits, timestamp_monotime, 1);
+	printf("Realigned with a bit slip at bit %hd.\n", found_position);
+	dcf_commit(&datetime, frame->timestamp_monotime);
+	dcf_frames_realigned++;
+
+	return 1;
+}
+
+// The state of the minute that is currently being received (see
+// dcf_process_partial).
+
+// The expected timestamp of the minute-end marker.
+static uint32_t stream_timestamp_monotime;
+// The number of bits that have been checked.
+static uint8_t stream_position = 0;
+// Set once one of the checks has failed.
+static uint8_t stream_failed;
+// The bits predicted for the minute, if stream_has_prediction.
+static uint64_t stream_predicted;
+static uint8_t stream_has_prediction;
+// Set once the complete minute has been decoded; the bits that have been
+// decoded, the result, and whether it comes from the prediction.
+static uint8_t stream_ready = 0;
+static uint64_t stream_bits, stream_erasures;
+static struct gregorian_date_time stream_datetime;
+static uint8_t stream_corrected;
+
+/**
+ * Checks a parity group of the current minute as soon as it's complete,
+ * and compares it with the prediction.
+ *
+ * @param frame
+ *     The bits received so far, aligned as in a complete frame.
+ */
+void dcf_stream_check_group(struct dcf_frame *frame, uint8_t start,
+	uint8_t end) {
+
+	uint64_t bits = frame->bits;
+	uint64_t erasures = frame->erasures;
+
+	if (stream_has_prediction) {
+		uint64_t differences = (bits ^ stream_predicted) & ~erasures &
+		                       bit_range(start, end);
+		uint8_t count = count_bits(&differences, start, end);
+		if (count) {
+			printf("Bits %hd to %hd differ from the prediction in "
+			       "%hd bits.\n", start, end - 1, count);
+		}
+	}
+
+	if (!dcf_fill_parity_erasure(&bits, &erasures, start, end) ||
+	    !dcf_repair_parity(&bits, frame->confidence, start, end)) {
+		printf("Bits %hd to %hd are corrupted.\n", start, end - 1);
+		stream_failed = 1;
+	}
+}
+
+/**
+ * Checks the bits that are not protected by parity, once they are
+ * complete.
+ */
+void dcf_stream_check_fixed_bits(struct dcf_frame *frame) {
+	uint64_t valid = ~frame->erasures;
+
+	if (BIT(valid, 38) && !BIT(frame->bits, 38)) {
+		puts("Start-of-encoded-time bit is not 1.\n");
+		stream_failed = 1;
+	}
+
+	if (BIT(valid, 40) && BIT(valid, 41) &&
+	    BIT(frame->bits, 40) == BIT(frame->bits, 41)) {
+		puts("CET and CEST bits don't have opposite values.\n");
+		stream_failed = 1;
+	}
+}
+
+/**
+ * Returns 1 if the bit with the given index has been received since the
+ * last call of dcf_process_partial.
+ */
+uint8_t dcf_stream_passed(uint8_t count, uint8_t index) {
+	uint8_t position = DCF_FRAME_BITS - index;
+	return stream_position < position && count >= position;
+}
+
+void dcf_process_partial(struct dcf_frame *partial) {
+	if (partial->timestamp_monotime != stream_timestamp_monotime) {
+		// A new minute has started.
+		stream_timestamp_monotime = partial->timestamp_monotime;
+		stream_position = 0;
+		stream_failed = 0;
+		stream_ready = 0;
+		stream_has_prediction = dcf_predict_bits(
+			partial->timestamp_monotime, &stream_predicted);
+	}
+
+	uint8_t count = find_index_of_highest_bit(&partial->bits);
+	if (count > DCF_FRAME_BITS) {
+		// A leap second; leave that to dcf_process.
+		stream_ready = 0;
+		return;
+	}
+
+	// Align the bits as they will be in the complete frame.
+	uint8_t shift = DCF_FRAME_BITS - count;
+	partial->bits <<= shift;
+	partial->erasures <<= shift;
+	for (uint8_t i = DCF_FRAME_MAX_BITS; i-- > 0; ) {
+		partial->confidence[i] = (i >= shift) ?
+			partial->confidence[i - shift] : 0;
+	}
+
+	if (dcf_stream_passed(count, 38)) {
+		dcf_stream_check_fixed_bits(partial);
+	}
+	if (dcf_stream_passed(count, 30)) {
+		dcf_stream_check_group(partial, 30, 38);
+	}
+	if (dcf_stream_passed(count, 23)) {
+		dcf_stream_check_group(partial, 23, 30);
+	}
+	if (dcf_stream_passed(count, 0)) {
+		dcf_stream_check_group(partial, 0, 23);
+
+		// The minute is complete; the bits are aligned already.
+		stream_bits = partial->bits;
+		stream_erasures = partial->erasures;
+
+		uint64_t predicted = stream_predicted |
+		                     (partial->bits & DCF_UNPREDICTABLE_MASK);
+
+		if (!stream_failed &&
+		    dcf_try_decode(partial, &stream_datetime)) {
+			stream_ready = 1;
+			stream_corrected = 0;
+		} else if (stream_has_prediction &&
+		           dcf_prediction_matches(partial, predicted)) {
+			puts("Using the predicted frame instead.\n");
+			dcf_fill_predicted_frame(partial, predicted,
+				partial->timestamp_monotime);
+			stream_ready = dcf_try_decode(partial,
+				&stream_datetime);
+			stream_corrected = 1;
+		}
+	}
+
+	stream_position = count;
+}
+
+/**
+ * Logs the decoding statistics.
+ */
+void dcf_print_statistics() {
+	printf("Frames decoded cleanly: %u, corrected from prediction: %u, "
+	       "realigned: %u.\n", dcf_frames_clean, dcf_frames_corrected,
+	       dcf_frames_realigned);
+}
+
+uint8_t dcf_process(struct dcf_frame *frame) {
+	dcf_accumulator_add(frame);
+
+	if (stream_ready && frame->bits == stream_bits &&
+	    frame->erasures == stream_erasures) {
+		// The minute has been decoded while it was being received.
+		stream_ready = 0;
+		dcf_commit(&stream_datetime, frame->timestamp_monotime);
+
+		if (stream_corrected) {
+			dcf_frames_corrected++;
+		} else {
+			dcf_frames_clean++;
+		}
+		dcf_print_statistics();
+
+		return 1;
+	}
+	stream_ready = 0;
+
+	// The prediction must be made before the clock is updated.
+	uint64_t predicted_bits = 0;
+	uint64_t *predicted = 0;
+	if (dcf_predict_bits(frame->timestamp_monotime, &predicted_bits)) {
+		predicted = &predicted_bits;
+	}
+
+	// The bits that can't be predicted are taken from the frame; only a
+	// regular minute is compared bit-by-bit.
+	uint64_t predicted_frame = predicted_bits |
+	                           (frame->bits & DCF_UNPREDICTABLE_MASK);
+	uint8_t prediction_matches = predicted &&
+	                             (frame->bits >> DCF_FRAME_BITS) == 1 &&
+	                             dcf_prediction_matches(frame,
+	                                                    predicted_frame);
+
+	struct dcf_frame alternative;
+
+	if (dcf_process_frame(frame, predicted)) {
+		dcf_frames_clean++;
+	} else if (prediction_matches) {
+		puts("Using the predicted frame instead.\n");
+
+		dcf_fill_predicted_frame(&alternative, predicted_frame,
+			frame->timestamp_monotime);
+		if (!dcf_process_frame(&alternative, predicted)) {
+			return 0;
+		}
+		dcf_frames_corrected++;
+	} else {
+		// Maybe the last few frames together make more sense.
+		puts("Trying the majority vote of the last frames...\n");
+
+		if (!dcf_accumulator_vote(&alternative) ||
+		    !dcf_process_frame(&alternative, predicted)) {
+			return 0;
+		}
+	}
+
+	dcf_print_statistics();
+
+	return 1;
 }
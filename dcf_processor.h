@@ -3,14 +3,73 @@
 
 #include <stdint.h>
 
+#include "dcf_receiver.h"
+
+/**
+ * The number of frames that have been decoded as they were received.
+ */
+extern uint16_t dcf_frames_clean;
+
 /**
- * Tries to process the received minute bits and timestamps.
+ * The number of frames that could not be decoded as they were received,
+ * but have been replaced by the frame predicted from the clock.
+ */
+extern uint16_t dcf_frames_corrected;
+
+/**
+ * The number of frames that could only be decoded after assuming that a
+ * second has been missed or detected twice.
+ */
+extern uint16_t dcf_frames_realigned;
+
+/**
+ * Tries to process a received frame.
+ *
+ * Erased bits are filled from the bits around them where possible (see
+ * dcf_check_range); frames with erasures that can't be filled in the
+ * bits that are actually used are rejected.
+ *
+ * Parity errors are repaired by flipping the least confident bit of the
+ * affected parity group, if its confidence is low enough.
+ *
+ * A frame with one bit too few or too many (a second that has been missed,
+ * or one that has been detected twice) is realigned: every position of the
+ * bit slip is tried, sharing the checks of the ranges that the slip leaves
+ * alone. The result is only used if all valid positions agree on the time,
+ * and match the prediction from the clock (if there is one).
+ *
+ * Once the clock has been set, the frame for the minute that has just
+ * ended can be predicted from it. If the received frame can't be decoded,
+ * but differs from the prediction in only a few bits (and the parities
+ * suggest that these are bit errors), the prediction is used instead.
+ *
+ * Otherwise, a frame that has been voted bit-by-bit
+ * from the last few received frames (see dcf_accumulator.h) is tried
+ * instead.
+ *
+ * If the minute has already been decoded by dcf_process_partial, the
+ * result is only committed.
  *
  * On success, the clock is adjusted accordingly.
  *
  * @returns
  *     On error, 0. On success, 1.
  */
-uint8_t dcf_process(uint64_t *minute_bits, uint32_t *timestamp_monotime);
+uint8_t dcf_process(struct dcf_frame *frame);
+
+/**
+ * Checks the minute that is currently being received (see
+ * dcf_poll_partial) while its bits arrive.
+ *
+ * Each parity group is checked (and compared with the prediction) as soon
+ * as it is complete, so errors are logged within a second. Once the last
+ * bit has arrived, the minute is decoded and validated; if the received
+ * frame at the minute-end marker matches, dcf_process only needs to commit
+ * the result.
+ *
+ * @param partial
+ *     As filled in by dcf_poll_partial; is modified.
+ */
+void dcf_process_partial(struct dcf_frame *partial);
 
 #endif
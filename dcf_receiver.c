@@ -4,34 +4,170 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
-#include <util/atomic.h>
 
 #include "dbg.h"
+#include "dcf_classifier.h"
 #include "led.h"
 #include "monotime.h"
 #include "util.h"
 
 /**
- * Is set to the received minute bits as part of the INT0 ISR whenever a
- * minute-end marker has been received.
+ * A single edge of the receiver signal, as recorded by the receiver ISR.
+ */
+struct dcf_edge {
+	// Timestamp in Timer 1 counts (see monotime_timer_ticks).
+	uint32_t timestamp_ticks;
+	// Timestamp in monotime, rounded to 1/256th of a second.
+	uint32_t timestamp_monotime;
+	// Non-zero for a rising edge.
+	uint8_t status;
+};
+
+// Must be a power of two; at most two edges arrive per second, so this
+// leaves the main loop plenty of time.
+#define EDGE_RINGBUF_SIZE 8
+#define EDGE_RINGBUF_PTR_MASK (EDGE_RINGBUF_SIZE - 1)
+
+/**
+ * Single-producer/single-consumer ring buffer of edges.
  *
- * To be used via dcf_poll_data.
+ * The receiver ISR is the only writer of edge_ringbuf_end, the main loop
+ * (dcf_poll_data) is the only writer of edge_ringbuf_pos.
+ * Both are single bytes, so they can be accessed without locking.
+ */
+static volatile struct dcf_edge edge_ringbuf[EDGE_RINGBUF_SIZE];
+static volatile uint8_t edge_ringbuf_pos = 0;
+static volatile uint8_t edge_ringbuf_end = 0;
+
+/**
+ * Set by the receiver ISR if an edge had to be dropped because the ring
+ * buffer was full; cleared by dcf_poll_data.
  */
-volatile uint64_t dcf_minute_bits = 0;
+static volatile uint8_t edge_ringbuf_overflow = 0;
+
+/**
+ * Pairs of edges that are closer to each other than this (in Timer 1 counts)
+ * are considered to be a glitch, and merged back into the surrounding pulse
+ * or gap.
+ * Set to 0 to disable the filter.
+ */
+#ifndef DCF_GLITCH_MAX
+#define DCF_GLITCH_MAX DCF_TICKS(20, 1000)
+#endif
+
+/**
+ * An edge that no other edge has followed for this long (in 1/256ths of a
+ * second) is released: DCF_GLITCH_MAX, plus the resolution of monotime and
+ * of the timestamps.
+ */
+#define GLITCH_RELEASE \
+	((int32_t) (DCF_GLITCH_MAX * 256 / MONOTIME_TIMER_HZ) + 2)
+
+// Made available globally by the header.
+uint16_t dcf_glitch_count = 0;
+uint8_t dcf_signal_lost = 0;
 
 /**
- * Is set to the timestamp of the minute-end-mark (start of the next minute)
- * as part of the INT0 ISR whenever a minute-end marker has been received.
+ * The value of dcf_glitch_count when it has last been logged.
  */
-volatile uint32_t dcf_timestamp_monotime = 0;
+static uint16_t logged_glitch_count = 0;
 
 /**
- * Guaranteed to be set to 1 by the INT0 ISR if and only if new values have
- * been written to dcf_minute_bits and dcf_timestamp_monotime.
+ * The most recent edge; it is held back until it's clear that it's not
+ * part of a glitch.
  */
-volatile uint8_t dcf_data_ready = 0;
+static struct dcf_edge held_edge;
+static uint8_t held_edge_valid = 0;
+
+/**
+ * Contains all bits from the current minute.
+ * This is filled by left-shifting over the course of the minute.
+ * If no minute is currently being processed, the variable is zero.
+ * Otherwise, there's always a leading '1' bit that is not part of the
+ * actual received data.
+ */
+static uint64_t minute_bits = 0;
+
+/**
+ * Marks the bits of minute_bits that could not be read (erasures); the
+ * corresponding bits in minute_bits are 0.
+ * Has no leading '1' bit.
+ */
+static uint64_t minute_erasures = 0;
+
+/**
+ * The number of bits in minute_bits (excluding the leading '1' bit).
+ */
+static uint8_t minute_bit_count = 0;
+
+/**
+ * The confidence values of the bits in minute_bits, in the order in which
+ * they have been received.
+ */
+static uint8_t minute_confidence[DCF_FRAME_MAX_BITS];
+
+/**
+ * Set if the current minute has started with a minute-end marker, i.e.
+ * minute_bit_count is the position in the minute.
+ */
+static uint8_t minute_synced = 0;
+
+/**
+ * The monotime of the minute-end marker that has started the current
+ * minute (if minute_synced).
+ */
+static uint32_t minute_start_monotime;
+
+/**
+ * Set whenever a bit has been added to the current minute, until it has
+ * been reported by dcf_poll_partial.
+ */
+static uint8_t minute_changed = 0;
+
+/**
+ * The timestamp of the most recent start of a second (rising edge), in
+ * Timer 1 counts.
+ */
+static uint32_t second_start_ticks;
+
+/**
+ * Set after the start of a second, until the bit of that second has been
+ * received.
+ */
+static uint8_t second_bit_pending = 0;
+
+/**
+ * The monotime (and Timer 1 counts) of the most recent valid start of a
+ * second, and whether it has not been reported by dcf_poll_second yet.
+ */
+static uint32_t second_timestamp_monotime;
+static uint32_t second_timestamp_ticks;
+static uint8_t second_ready = 0;
+
+// A second start that is this close to a whole number of seconds after the
+// previous one is accepted as such, even if the gap itself was corrupted.
+#define DCF_SECOND_TOLERANCE DCF_TICKS(1, 8)
+
+// Up to this many seconds without any usable edge may be bridged with
+// erasures.
+#define DCF_MAX_SECONDS_ELAPSED 10
+
+// The number of bits in a minute without a leap second.
+#define DCF_MINUTE_BITS 59
 
 void dcf_receiver_init() {
+	dcf_classifier_init();
+
+#ifdef DCF_RECEIVER_ICP1
+	// configure PB0 (the ICP1 PIN) as a tri-state input.
+	DDRB &= ~(1 << PB0);
+	PORTB &= ~(1 << PB0);
+
+	// enable the input capture noise canceler, wait for a rising edge.
+	TCCR1B |= (1 << ICNC1) | (1 << ICES1);
+	TIFR1 = (1 << ICF1);
+	TIMSK1 |= (1 << ICIE1);
+#else
 	// configure PD2 (the INT0 PIN) as a tri-state input.
 	DDRD &= ~(1 << PD2);
 	PORTD &= ~(1 << PD2);
@@ -39,105 +175,468 @@ void dcf_receiver_init() {
 	// enable INTO on rising and falling edge.
 	EICRA = 1 << ISC00;
 	EIMSK = 1 << INT0;
+#endif
 }
 
-uint8_t dcf_poll_data(uint64_t *minute_bits, uint32_t *timestamp_monotime) {
-	if (!dcf_data_ready) {
-		return 0;
-	}
+/**
+ * Drops the current minute.
+ */
+static void dcf_reset_minute() {
+	minute_bits = 0;
+	minute_synced = 0;
+	dbg_toggle_red();
+}
 
-	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-		*minute_bits = dcf_minute_bits;
-		*timestamp_monotime = dcf_timestamp_monotime;
+/**
+ * Appends a single bit to the current minute, starting a new minute if
+ * necessary.
+ *
+ * @param bit:
+ *     The bit value; must be 0 for erasures.
+ * @param confidence:
+ *     The confidence value; must be 0 for erasures.
+ * @param erasure:
+ *     1 if the bit could not be read.
+ */
+static void dcf_push_bit(uint8_t bit, uint8_t confidence, uint8_t erasure) {
+	if (minute_bits & ((uint64_t) 1 << 63)) {
+		// Something is awfully wrong here. Maybe we missed
+		// the minute-end marker.
 
-		dcf_data_ready = 0;
+		// Start a new minute.
+		dcf_reset_minute();
 	}
 
-	return 1;
+	if (minute_bits == 0) {
+		// Start a new minute.
+		minute_bits = 1;
+		minute_erasures = 0;
+		minute_bit_count = 0;
+	}
+
+	minute_bits = (minute_bits << 1) | bit;
+	minute_erasures = (minute_erasures << 1) | erasure;
+	minute_confidence[minute_bit_count++] = confidence;
+	minute_changed = 1;
 }
 
-ISR(INT0_vect) {
-	// Edge type (rising or falling).
-	uint8_t status = PIND & (1 << PD2);
+/**
+ * Copies the current minute to frame; the timestamp is left alone.
+ */
+static void dcf_fill_frame(struct dcf_frame *frame) {
+	frame->bits = minute_bits;
+	frame->erasures = minute_erasures;
 
-	// Stores the monotime of the previous interrupt.
-	static uint32_t monotime_previous = 0;
-	// Calculate time since the previous interrupt (= pos/neg duty cycle).
-	uint32_t duty_cycle = monotime_current - monotime_previous;
-	monotime_previous = monotime_current;
+	// Reverse the confidence values to match the bits.
+	for (uint8_t i = 0; i < DCF_FRAME_MAX_BITS; i++) {
+		if (i < minute_bit_count) {
+			frame->confidence[i] = minute_confidence[
+				minute_bit_count - 1 - i];
+		} else {
+			frame->confidence[i] = 0;
+		}
+	}
+}
 
-	led_set(status);
+/**
+ * Determines how many whole seconds an interval spans.
+ *
+ * @returns
+ *     The number of seconds, or 0 if the interval is not within
+ *     DCF_SECOND_TOLERANCE of 1 to DCF_MAX_SECONDS_ELAPSED seconds.
+ */
+static uint8_t dcf_seconds_elapsed(uint32_t interval) {
+	uint32_t seconds = (interval + DCF_TICKS(1, 2)) / DCF_TICKS(1, 1);
+	if (seconds == 0 || seconds > DCF_MAX_SECONDS_ELAPSED) {
+		return 0;
+	}
 
-	// Contains all bits from the current minute.
-	// This is filled by left-shifting over the course of the minute.
-	// If no minute is currently being processed, the variable is zero.
-	// Otherwise, there's always a leading '1' bit that is not part of the
-	// actual received data.
-	static uint64_t minute_bits = 0;
+	uint32_t expected = seconds * DCF_TICKS(1, 1);
+	if ((interval + DCF_SECOND_TOLERANCE < expected) ||
+	    (interval > expected + DCF_SECOND_TOLERANCE)) {
+		return 0;
+	}
 
-	if (status) {
-		// Rising edge; analyze length of the negative duty cycle:
-		//
-		//  0.7s - 1.0s: regular second
-		//  1.7s - 2.0s: start of new minute
-
-		if ((duty_cycle >= 179) && (duty_cycle <= 256)) {
-			// It was just a regular second; everything is alright.
-		} else if ((duty_cycle >= 435) && (duty_cycle <= 512)) {
-			// Alright; this minute is done.
-			// Time to pass the accumulated bits on for analyzing.
-			// (this includes checking whether there are any/the
-			//  right number of bits and whether they make the
-			//  least bit of sense).
-			dcf_minute_bits = minute_bits;
-			dcf_timestamp_monotime = monotime_current;
-			minute_bits = 0;
-			dcf_data_ready = 1;
-		} else {
-			// This is an illegal duty cycle; the signal has
-			// been corrupted.
+	return seconds;
+}
 
-			// Better luck next minute.
-			minute_bits = 0;
-			dbg_toggle_red();
-		}
-	} else {
-		// Falling edge (bit has been received).
-		if (minute_bits & ((uint64_t) 1 << 63)) {
-			// Something is awfully wrong here. Maybe we missed
-			// the minute-end marker.
+/**
+ * Classifies a single edge of the receiver signal and assembles the minute
+ * bits.
+ * Invoked by dcf_poll_data for each edge that the ISR has recorded.
+ *
+ * Once a minute has started with a minute-end marker, seconds that can't be
+ * read are recorded as erasures, so the position in the minute is kept.
+ *
+ * @returns
+ *     1 if the edge was a minute-end marker; frame has been filled in that
+ *     case.
+ *     0 else.
+ */
+static uint8_t dcf_classify_edge(struct dcf_edge *edge,
+	struct dcf_frame *frame) {
 
-			// Start a new minute.
-			minute_bits = 0;
-			dbg_toggle_red();
-		}
+	// Stores the timestamp of the previous edge.
+	static uint32_t ticks_previous = 0;
+	// Stores the length of the previous positive duty cycle.
+	static uint32_t pulse_previous = 0;
+	// Calculate time since the previous edge (= pos/neg duty cycle).
+	uint32_t duty_cycle = edge->timestamp_ticks - ticks_previous;
+	ticks_previous = edge->timestamp_ticks;
 
-		if (minute_bits == 0) {
-			// Start a new minute.
-			minute_bits = 1;
+	led_set(edge->status);
+
+	if (!edge->status) {
+		// Falling edge (bit has been received).
+		pulse_previous = duty_cycle;
+		if (!second_bit_pending) {
+			// We haven't seen the start of this second.
+			return 0;
 		}
+		second_bit_pending = 0;
 
 		// Analyze length of the positive duty cycle:
 		//
 		//  0.07s - 0.13s: bit 0
 		//  0.17s - 0.23s: bit 1
 
-		if ((duty_cycle >= 10) && (duty_cycle <= 33)) {
+		uint8_t confidence;
+		uint8_t pulse = dcf_classify_pulse(duty_cycle, &confidence);
+
+		if (pulse == DCF_PULSE_0) {
 			// We have received a "0" bit.
-			minute_bits = minute_bits << 1;
-			minute_bits |= 0;
-		} else if ((duty_cycle >= 44) && (duty_cycle <= 59)) {
+			dcf_push_bit(0, confidence, 0);
+		} else if (pulse == DCF_PULSE_1) {
 			// We have received a "1" bit.
-			minute_bits = minute_bits << 1;
-			minute_bits |= 1;
+			dcf_push_bit(1, confidence, 0);
 		} else {
-			// Illegal positive duty cycle length; the signal is
-			// corrupted.
-			//
-			// Better luck next minute.
+			// Illegal positive duty cycle length; the bit is
+			// corrupted, but we know where we are.
+			dcf_push_bit(0, 0, 1);
+		}
+
+		return 0;
+	}
+
+	// Rising edge (start of a second); analyze length of the negative
+	// duty cycle, plus the positive one before it:
+	//
+	//  0.875s - 1.125s: regular second
+	//  1.875s - 2.125s: start of new minute
+	//
+	// If that's inconclusive, fall back to the time since the start of
+	// the previous second.
+
+	// Without a falling edge in between, the duty cycle spans the whole
+	// second already.
+	uint8_t gap = dcf_classify_gap(duty_cycle, pulse_previous);
+	pulse_previous = 0;
+	uint8_t seconds;
+	if (gap == DCF_GAP_SECOND) {
+		seconds = 1;
+	} else if (gap == DCF_GAP_MINUTE) {
+		seconds = 2;
+	} else if (second_start_ticks != 0) {
+		seconds = dcf_seconds_elapsed(
+			edge->timestamp_ticks - second_start_ticks);
+	} else {
+		seconds = 0;
+	}
+
+	second_start_ticks = edge->timestamp_ticks;
+
+	if (second_bit_pending) {
+		// The previous second had no readable pulse at all.
+		dcf_push_bit(0, 0, 1);
+	}
+	second_bit_pending = 1;
+
+	if (seconds == 0) {
+		// This is an illegal duty cycle; the signal has
+		// been corrupted.
+
+		// Better luck next minute.
+		dcf_reset_minute();
+		return 0;
+	}
+
+	second_timestamp_monotime = edge->timestamp_monotime;
+	second_timestamp_ticks = edge->timestamp_ticks;
+	second_ready = 1;
 
-			minute_bits = 0;
-			dbg_toggle_red();
+	if (dcf_signal_lost) {
+		dcf_signal_lost = 0;
+		puts("Signal is back.\n");
+	}
+
+	// Did the minute end (the last second of each minute has no pulse)?
+	uint8_t minute_end;
+	if (minute_synced) {
+		minute_end = (seconds >= 2) &&
+		             (minute_bit_count + seconds - 2 >= DCF_MINUTE_BITS);
+	} else {
+		minute_end = (gap == DCF_GAP_MINUTE);
+	}
+
+	if (minute_end) {
+		seconds -= 1;
+	}
+
+	// Each second that we've skipped is an erasure.
+	while (seconds > 1 && minute_bits != 0) {
+		dcf_push_bit(0, 0, 1);
+		seconds -= 1;
+	}
+
+	if (!minute_end) {
+		// It was just a regular second; everything is alright.
+		return 0;
+	}
+
+	// Alright; this minute is done.
+	// Time to pass the accumulated bits on for analyzing.
+	// (this includes checking whether there are any/the
+	//  right number of bits and whether they make the
+	//  least bit of sense).
+	dcf_fill_frame(frame);
+	frame->timestamp_monotime = edge->timestamp_monotime;
+	frame->timestamp_ticks = edge->timestamp_ticks;
+
+	minute_bits = 0;
+	minute_synced = 1;
+	minute_start_monotime = edge->timestamp_monotime;
+	minute_changed = 0;
+
+	// Follow the receiver's pulse characteristics.
+	dcf_classifier_adapt();
+
+	return 1;
+}
+
+/**
+ * Filters out glitches: if edge follows the held-back edge within
+ * DCF_GLITCH_MAX, both are dropped. Otherwise, the held-back edge is
+ * released, and edge is held back in its place.
+ * Invoked by dcf_poll_edge for each edge that the ISR has recorded.
+ *
+ * @returns
+ *     1 if an edge has been released to result, 0 else.
+ */
+static uint8_t dcf_deglitch_edge(struct dcf_edge *edge,
+	struct dcf_edge *result) {
+
+	if (held_edge_valid &&
+	    (edge->timestamp_ticks - held_edge.timestamp_ticks <
+	     DCF_GLITCH_MAX)) {
+		// A spike or a dropout; pretend it never happened.
+		held_edge_valid = 0;
+		dcf_glitch_count++;
+		return 0;
+	}
+
+	uint8_t released = held_edge_valid;
+	*result = held_edge;
+
+	held_edge = *edge;
+	held_edge_valid = 1;
+
+	return released;
+}
+
+/**
+ * Takes the next edge that has passed the glitch filter: the held-back
+ * edge is released once another edge has followed it after DCF_GLITCH_MAX
+ * (see dcf_deglitch_edge), or once GLITCH_RELEASE has passed without one.
+ * Invoked by dcf_poll_frame.
+ *
+ * @returns
+ *     1 if an edge has been released to result, 0 else.
+ */
+static uint8_t dcf_poll_edge(struct dcf_edge *result) {
+	// Taken before the ring buffer is found empty, so an edge that the ISR
+	// records after that is too late to cancel the held-back edge.
+	uint32_t now = monotime_current_get();
+
+	while (edge_ringbuf_pos != edge_ringbuf_end) {
+		uint8_t pos = edge_ringbuf_pos;
+		struct dcf_edge edge = edge_ringbuf[pos];
+		// Only now release the slot to the ISR.
+		edge_ringbuf_pos = (pos + 1) & EDGE_RINGBUF_PTR_MASK;
+
+		if (dcf_deglitch_edge(&edge, result)) {
+			return 1;
+		}
+	}
+
+	if (held_edge_valid &&
+	    (int32_t) (now - held_edge.timestamp_monotime) > GLITCH_RELEASE) {
+		*result = held_edge;
+		held_edge_valid = 0;
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Checks whether the next second has failed to start in time, and sets
+ * dcf_signal_lost if so.
+ * Invoked by dcf_poll_frame.
+ */
+static void dcf_check_signal() {
+	if (!minute_synced || dcf_signal_lost) {
+		return;
+	}
+
+	// The second whose start we've seen last; the one before the
+	// minute-end marker lasts two seconds.
+	uint8_t second = minute_bits ? minute_bit_count : 0;
+	second += second_bit_pending;
+	uint32_t expected = (second >= DCF_MINUTE_BITS) ? 2 << 8 : 1 << 8;
+
+	uint32_t elapsed = monotime_current_get() - second_timestamp_monotime;
+	if (elapsed > expected + DCF_SIGNAL_TIMEOUT) {
+		dcf_signal_lost = 1;
+		printf("Signal lost after second %hd.\n", second - 1);
+	}
+}
+
+uint8_t dcf_poll_frame(struct dcf_frame *frame) {
+
+	if (edge_ringbuf_overflow) {
+		// We've lost edges; whatever we have is garbage.
+		edge_ringbuf_overflow = 0;
+		held_edge_valid = 0;
+		second_bit_pending = 0;
+		second_start_ticks = 0;
+		dcf_reset_minute();
+		puts("Receiver edge buffer overflow.\n");
+	}
+
+	struct dcf_edge edge;
+	while (dcf_poll_edge(&edge)) {
+		if (dcf_classify_edge(&edge, frame)) {
+			if (dcf_glitch_count != logged_glitch_count) {
+				logged_glitch_count = dcf_glitch_count;
+				printf("Glitches absorbed so far: %u.\n",
+					dcf_glitch_count);
+			}
+			return 1;
 		}
 	}
+
+	dcf_check_signal();
+
+	return 0;
+}
+
+uint8_t dcf_poll_partial(struct dcf_frame *partial) {
+	if (!minute_changed) {
+		return 0;
+	}
+	minute_changed = 0;
+
+	if (!minute_synced || minute_bits == 0) {
+		return 0;
+	}
+
+	dcf_fill_frame(partial);
+	partial->timestamp_monotime = minute_start_monotime +
+	                              ((uint32_t) 60 << 8);
+
+	return 1;
 }
+
+uint8_t dcf_poll_second(uint32_t *timestamp_monotime,
+	uint32_t *timestamp_ticks) {
+
+	if (!second_ready) {
+		return 0;
+	}
+
+	*timestamp_monotime = second_timestamp_monotime;
+	*timestamp_ticks = second_timestamp_ticks;
+	second_ready = 0;
+
+	return 1;
+}
+
+uint8_t dcf_poll_data(uint64_t *result_bits,
+	uint32_t *result_timestamp_monotime) {
+
+	struct dcf_frame frame;
+
+	if (!dcf_poll_frame(&frame)) {
+		return 0;
+	}
+
+	*result_bits = frame.bits;
+	*result_timestamp_monotime = frame.timestamp_monotime;
+
+	return 1;
+}
+
+/**
+ * Records a single edge of the receiver signal to the ring buffer.
+ * Invoked by the receiver ISR; everything else is left to dcf_poll_data.
+ *
+ * @param status:
+ *     The edge type; non-zero for a rising edge.
+ * @param counter:
+ *     The Timer 1 counter value at the time of the edge.
+ */
+static inline void dcf_record_edge(uint8_t status, uint16_t counter) {
+	uint8_t end = edge_ringbuf_end;
+	uint8_t next_end = (end + 1) & EDGE_RINGBUF_PTR_MASK;
+
+	if (next_end == edge_ringbuf_pos) {
+		// The main loop hasn't kept up; drop the edge.
+		edge_ringbuf_overflow = 1;
+		return;
+	}
+
+	uint32_t timestamp_ticks;
+	edge_ringbuf[end].timestamp_monotime = monotime_from_counter(
+		counter, &timestamp_ticks);
+	edge_ringbuf[end].timestamp_ticks = timestamp_ticks;
+	edge_ringbuf[end].status = status;
+
+	// Only now publish the edge to the main loop.
+	edge_ringbuf_end = next_end;
+}
+
+#ifdef DCF_RECEIVER_ICP1
+
+ISR(TIMER1_CAPT_vect) {
+	// The hardware has latched the timer at the edge; the edge type is
+	// the one that the capture unit has been waiting for.
+	uint16_t counter = ICR1;
+	uint8_t status = TCCR1B & (1 << ICES1);
+
+	// Wait for the opposite of the current level.
+	// Re-reading the pin (instead of simply toggling ICES1) keeps us in
+	// sync even if we've missed an edge.
+	if (PINB & (1 << PB0)) {
+		TCCR1B &= ~(1 << ICES1);
+	} else {
+		TCCR1B |= (1 << ICES1);
+	}
+
+	// Changing the edge type may trigger a spurious capture.
+	TIFR1 = (1 << ICF1);
+
+	dcf_record_edge(status, counter);
+}
+
+#else
+
+ISR(INT0_vect) {
+	// Latch the timer as early as possible.
+	uint16_t counter = TCNT1;
+	// Edge type (rising or falling).
+	uint8_t status = PIND & (1 << PD2);
+
+	dcf_record_edge(status, counter);
+}
+
+#endif
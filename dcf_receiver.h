@@ -1,4 +1,10 @@
-// Provides raw bits from a DCF77 receiver at PIN DC; uses INT0.
+// Provides raw bits from a DCF77 receiver.
+//
+// By default, the receiver is connected to PD2 and edges are detected via
+// INT0; they are timestamped by reading Timer 1 in the ISR.
+// If DCF_RECEIVER_ICP1 is defined, the receiver is connected to PB0 instead,
+// and edges are timestamped by the Timer 1 input capture unit, which is
+// unaffected by interrupt latency.
 
 #ifndef DCF77AVR_DCFISR_H_
 #define DCF77AVR_DCFISR_H_
@@ -6,7 +12,59 @@
 #include <stdint.h>
 
 /**
- * Initializes the INT0 I/O pin and ISR.
+ * The maximum number of bits that a single frame can hold.
+ */
+#define DCF_FRAME_MAX_BITS 63
+
+/**
+ * The bits received in one minute, along with soft-decision information.
+ */
+struct dcf_frame {
+	// As minute_bits in dcf_poll_data.
+	uint64_t bits;
+
+	// Marks the bits that could not be read (erasures); they are 0 in
+	// bits. Unlike bits, this has no leading '1' bit.
+	uint64_t erasures;
+
+	// As timestamp_monotime in dcf_poll_data.
+	uint32_t timestamp_monotime;
+
+	// The same, in Timer 1 counts (see monotime_timer_ticks); only set
+	// by dcf_poll_frame.
+	uint32_t timestamp_ticks;
+
+	// confidence[i] belongs to bit #i of bits (the LSB is #0); it
+	// describes how clearly the pulse length was on one side of the
+	// 0/1 decision threshold (0: not at all; DCF_CONFIDENCE_MAX: at
+	// least as clearly as a pulse of nominal length).
+	uint8_t confidence[DCF_FRAME_MAX_BITS];
+};
+
+/**
+ * The number of glitches (pairs of edges less than DCF_GLITCH_MAX apart)
+ * that have been merged back into the surrounding signal since
+ * initialization.
+ *
+ * Glitches are dropped before the pulses are classified, so a single noise
+ * spike no longer costs the whole minute.
+ */
+extern uint16_t dcf_glitch_count;
+
+/**
+ * Set while the receiver has lost the signal, i.e. once the next second
+ * has failed to start for DCF_SIGNAL_TIMEOUT (in 1/256ths of a second) past
+ * its expected start; cleared by the next second start.
+ *
+ * Only checked while the receiver keeps its position in the minute (see
+ * dcf_poll_data). Updated as part of dcf_poll_frame/dcf_poll_data.
+ */
+extern uint8_t dcf_signal_lost;
+
+#define DCF_SIGNAL_TIMEOUT 128
+
+/**
+ * Initializes the receiver I/O pin and ISR.
  *
  * Must run with interrupts globally disabled.
  * The receiver interrupt will become active once interrupts have been
@@ -19,9 +77,21 @@ void dcf_receiver_init();
  *
  * A new set becomes available every time a minute-end marker is received.
  *
+ * The receiver ISR only records the edges of the signal; they are
+ * deglitched, classified and assembled to minute bits as part of this call,
+ * so it should be called regularly from the main loop.
+ * As each edge is held back until it's clear that it's not part of a
+ * glitch, the minute-end marker is reported at least DCF_GLITCH_MAX after it
+ * (its timestamp is not affected).
+ *
  * The data is not guaranteed to be consistent or even contain the correct
  * number of bits.
  *
+ * Once the receiver has seen a minute-end marker, it keeps track of its
+ * position in the minute; seconds that can't be read are then recorded as
+ * erasures (see struct dcf_frame) instead of discarding the minute.
+ * dcf_poll_data reports erasures as 0 bits.
+ *
  * @result:
  *     1 if data has been available, 0 else.
  * @param minute_bits:
@@ -35,9 +105,67 @@ void dcf_receiver_init();
  * @param timestamp_monotime:
  *     If the result is 1, the monotime timestamp of the start of the next
  *     minute is stored here.
+ *     It is derived from the Timer 1 counter at the time of the edge, and
+ *     rounded to the nearest 1/256th of a second.
  *
- * This method is interrupt-safe.
+ * Must not be called from within an ISR.
  */
 uint8_t dcf_poll_data(uint64_t *minute_bits, uint32_t *timestamp_monotime);
 
+/**
+ * Asks for the timestamp of the most recent start of a second.
+ *
+ * Only second starts that are consistent with the timing of the previous
+ * ones are reported (including minute-end markers). Edges are only
+ * processed as part of dcf_poll_frame/dcf_poll_data; if several seconds
+ * have started since the last call, only the most recent one is reported.
+ *
+ * @result:
+ *     1 if a second has started since the last call, 0 else.
+ * @param timestamp_monotime:
+ *     If the result is 1, the monotime of the start of the second (the
+ *     rising edge of the pulse) is stored here.
+ * @param timestamp_ticks:
+ *     If the result is 1, the same is stored here in Timer 1 counts (see
+ *     monotime_timer_ticks).
+ *
+ * Must not be called from within an ISR.
+ */
+uint8_t dcf_poll_second(uint32_t *timestamp_monotime,
+	uint32_t *timestamp_ticks);
+
+/**
+ * As dcf_poll_data, but additionally provides a confidence value for each
+ * received bit.
+ *
+ * @result:
+ *     1 if data has been available, 0 else.
+ * @param frame:
+ *     If the result is 1, the received frame is stored here.
+ *
+ * Must not be called from within an ISR.
+ */
+uint8_t dcf_poll_frame(struct dcf_frame *frame);
+
+/**
+ * Asks for the bits of the minute that is currently being received, so
+ * that they can be checked before the minute has ended.
+ *
+ * Only minutes that have started with a minute-end marker are reported,
+ * so the number of bits is the position in the minute.
+ * Edges are only processed as part of dcf_poll_frame/dcf_poll_data.
+ *
+ * @result:
+ *     1 if bits have been added to the current minute since the last
+ *     call, 0 else.
+ * @param partial:
+ *     If the result is 1, the bits received so far are stored here, in
+ *     the same format as by dcf_poll_frame. The timestamp is the one at
+ *     which the minute-end marker is expected (for a minute without a leap
+ *     second).
+ *
+ * Must not be called from within an ISR.
+ */
+uint8_t dcf_poll_partial(struct dcf_frame *partial);
+
 #endif
@@ -1,36 +1,261 @@
 #include "gregorian_calendar.h"
 
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+
 #include "dbg.h"
+#include "monotime.h"
 #include "util.h"
 
+// The number of days in a gregorian cycle (400 years), and in the first
+// and the other centuries of a cycle.
+#define DAYS_PER_CYCLE ((uint32_t) 365 * 400 + 97)
+#define DAYS_PER_FIRST_CENTURY ((uint32_t) 365 * 100 + 25)
+#define DAYS_PER_CENTURY ((uint32_t) 365 * 100 + 24)
+
+// The UNIX date of 2000-01-01 (30 years, 7 leap years).
+#define UNIX_DATE_2000 ((uint32_t) 365 * 30 + 7)
+
+/**
+ * The number of days before the first day of each month (January = 0) in
+ * a year without a leap day.
+ */
+static const uint16_t days_before_month[12] PROGMEM = {
+	0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+};
+
+/**
+ * The number of days before the first century of a cycle, by century of
+ * cycle.
+ */
+static const uint32_t days_before_century[4] PROGMEM = {
+	0,
+	DAYS_PER_FIRST_CENTURY,
+	DAYS_PER_FIRST_CENTURY + DAYS_PER_CENTURY,
+	DAYS_PER_FIRST_CENTURY + 2 * DAYS_PER_CENTURY
+};
+
+/**
+ * Maps the difference between the actual day of week and the one that the
+ * date would have in the first century of a cycle (mod 7) to the century of
+ * cycle; 0xff where no century matches.
+ *
+ * Moving a date by one century shifts its day of week by 36525 or 36524
+ * days (mod 7); the second row is for dates in the first two months of
+ * year 0, which are not shifted by the leap day that year 0 only has in
+ * the first century.
+ */
+static const uint8_t century_of_cycle_by_day_of_week[2][7] PROGMEM = {
+	{0, 3, 0xff, 2, 0xff, 1, 0xff},
+	{0, 0xff, 3, 0xff, 2, 0xff, 1}
+};
+
 // Made available externally via the header file.
 struct gregorian_date_time current_date_time;
 
+// Made available externally via the header file.
+int8_t current_epoch_fraction = 0;
+
+/**
+ * The UNIX time of the end of the hour in which current_date_time has been
+ * set; announcements take effect from then on.
+ */
+static uint32_t announcement_end;
+
+/**
+ * The UNIX time during the announced leap second (which is also the UNIX
+ * time of the second after it), if leap_second_pending is set.
+ */
+static uint32_t leap_second_unix_time;
+static uint8_t leap_second_pending;
+
+/**
+ * Incremented whenever the fields of the clock that the interrupts use
+ * (the UNIX time, the epoch and the leap second) change. Those are only
+ * changed by the interrupts, or with interrupts disabled, so readers
+ * outside an ISR never see a change halfway; they only need to retry if
+ * the sequence has changed (see gregorian_calendar_snapshot).
+ */
+static volatile uint8_t sequence = 0;
+
+/**
+ * The date-time derived from current_date_time by gregorian_calendar_now,
+ * and whether it is up to date.
+ */
+static struct gregorian_date_time now;
+static uint8_t now_in_leap_second;
+static uint8_t now_valid = 0;
+
 void gregorian_calendar_init() {
+	struct gregorian_date_time datetime;
+
 	// Set the alert bit to warn about the wrong date.
-	current_date_time.call_bit = 1;
-	current_date_time.timezone = +1;
-	current_date_time.timezone_change_announced = 0;
-	current_date_time.time.leap_second_announced = 0;
-
-	current_date_time.time.second = 0;
-	current_date_time.time.minute = 0;
-	current_date_time.time.hour = 0;
-	current_date_time.date.day_of_month = 1;
-	current_date_time.date.month = 1;
-	current_date_time.date.year = 15;
-	current_date_time.date.century = 20;
-	current_date_time.date.day_of_week = 4;
-
-	gregorian_date_calculate_unix_date(&current_date_time.date);
-	gregorian_date_time_calculate_unix_time(&current_date_time);
-
-	current_date_time.epoch_monotime = -current_date_time.unix_time;
+	datetime.call_bit = 1;
+	datetime.timezone = +1;
+	datetime.timezone_change_announced = 0;
+	datetime.time.leap_second_announced = 0;
+
+	datetime.time.second = 0;
+	datetime.time.minute = 0;
+	datetime.time.hour = 0;
+	datetime.date.day_of_month = 1;
+	datetime.date.month = 1;
+	datetime.date.year = 15;
+	datetime.date.century = 20;
+	datetime.date.day_of_week = 4;
+
+	gregorian_date_calculate_unix_date(&datetime.date);
+	gregorian_date_time_calculate_unix_time(&datetime);
+
+	// The clock starts along with the monotonic clock.
+	datetime.epoch_monotime = -(datetime.unix_time << 8);
+	gregorian_calendar_set(&datetime);
+}
+
+void gregorian_calendar_set(struct gregorian_date_time *datetime) {
+	// Time zones are offset by whole hours, so the local hour ends with
+	// the UTC hour.
+	uint32_t hour_end = datetime->unix_time + 3600 -
+	                    datetime->time.minute * 60 - datetime->time.second;
+
+	// Only the fields that the interrupts use need to be written with
+	// interrupts disabled.
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		current_date_time.unix_time = datetime->unix_time;
+		current_date_time.unix_era = datetime->unix_era;
+		current_date_time.epoch_monotime = datetime->epoch_monotime;
+		leap_second_unix_time = hour_end;
+		leap_second_pending = datetime->time.leap_second_announced;
+		sequence++;
+		monotime_epoch_set();
+	}
+
+	current_date_time.date = datetime->date;
+	current_date_time.time = datetime->time;
+	current_date_time.timezone = datetime->timezone;
+	current_date_time.timezone_change_announced =
+		datetime->timezone_change_announced;
+	current_date_time.call_bit = datetime->call_bit;
+	announcement_end = hour_end;
+
+	now_valid = 0;
+}
+
+void gregorian_calendar_move_epoch(int8_t step, int8_t fraction) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		current_date_time.epoch_monotime += step;
+		current_epoch_fraction = fraction;
+		sequence++;
+		monotime_epoch_moved();
+	}
+}
+
+void gregorian_calendar_snapshot(
+	struct gregorian_calendar_snapshot *snapshot) {
+
+	uint8_t start;
+
+	do {
+		start = sequence;
+		MEMORY_BARRIER();
+
+		snapshot->monotime = monotime_current_get();
+		snapshot->unix_time = current_date_time.unix_time;
+		snapshot->unix_era = current_date_time.unix_era;
+		snapshot->epoch_monotime = current_date_time.epoch_monotime;
+		snapshot->in_leap_second = leap_second_pending &&
+			(snapshot->unix_time == leap_second_unix_time);
+
+		MEMORY_BARRIER();
+	} while (start != sequence);
+}
+
+void gregorian_calendar_tick() {
+	sequence++;
+
+	if (leap_second_pending &&
+	    current_date_time.unix_time == leap_second_unix_time) {
+		// The leap second is over; the UNIX time repeats, so the epoch
+		// moves instead.
+		current_date_time.epoch_monotime += 0x100;
+		leap_second_pending = 0;
+		return;
+	}
+
+	current_date_time.unix_time++;
+	if (current_date_time.unix_time == 0) {
+		current_date_time.unix_era++;
+	}
+}
+
+const struct gregorian_date_time *gregorian_calendar_now() {
+	struct gregorian_calendar_snapshot snapshot;
+	gregorian_calendar_snapshot(&snapshot);
+
+	uint32_t unix_time = snapshot.unix_time;
+	uint8_t unix_era = snapshot.unix_era;
+	uint8_t in_leap_second = snapshot.in_leap_second;
+	now.epoch_monotime = snapshot.epoch_monotime;
+
+	if (now_valid && unix_time == now.unix_time &&
+	    unix_era == now.unix_era &&
+	    in_leap_second == now_in_leap_second) {
+
+		return &now;
+	}
+
+	// Once the announcements have taken effect, apply them to the clock.
+	// The flags and the timezone are only changed here and when the clock
+	// is set (never from an ISR), so they don't need to be accessed
+	// atomically.
+	if ((int32_t) (unix_time - announcement_end) >= 0 && !in_leap_second) {
+		if (current_date_time.timezone_change_announced) {
+			switch (current_date_time.timezone) {
+			case +1:
+				current_date_time.timezone = +2;
+				break;
+			case +2:
+				current_date_time.timezone = +1;
+				break;
+			}
+		}
+
+		current_date_time.timezone_change_announced = 0;
+		current_date_time.time.leap_second_announced = 0;
+	}
+
+	now.timezone = current_date_time.timezone;
+	now.timezone_change_announced =
+		current_date_time.timezone_change_announced;
+	now.time.leap_second_announced =
+		current_date_time.time.leap_second_announced;
+	now.call_bit = current_date_time.call_bit;
+
+	if (in_leap_second) {
+		// Shown as the 61st second of the minute before.
+		gregorian_date_time_from_unix_time(&now,
+			unix_era - (unix_time == 0), unix_time - 1);
+		now.time.second = 60;
+		now.unix_time = unix_time;
+		now.unix_era = unix_era;
+	} else {
+		dbg_benchmark("Date-time converted from UNIX time",
+			gregorian_date_time_from_unix_time(&now, unix_era,
+			                                   unix_time));
+	}
+
+	now_in_leap_second = in_leap_second;
+	now_valid = 1;
+
+	return &now;
 }
 
 void gregorian_date_time_increment(struct gregorian_date_time *datetime) {
 	// Next second.
 	datetime->unix_time++;
+	if (datetime->unix_time == 0) {
+		datetime->unix_era++;
+	}
 	datetime->time.second += 1;
 
 	if (datetime->time.second < 60) {
@@ -54,6 +279,9 @@ void gregorian_date_time_increment(struct gregorian_date_time *datetime) {
 	datetime->time.minute = 0;
 	if (datetime->time.leap_second_announced) {
 		// The UNIX time gets decremented when leaving a leap second.
+		if (datetime->unix_time == 0) {
+			datetime->unix_era--;
+		}
 		datetime->unix_time--;
 		datetime->epoch_monotime += 0x100;
 		datetime->time.leap_second_announced = 0;
@@ -112,7 +340,7 @@ void gregorian_date_time_increment(struct gregorian_date_time *datetime) {
 	datetime->date.month = 1;
 	datetime->date.year += 1;
 
-	if (datetime->date.year <= 100) {
+	if (datetime->date.year < 100) {
 		return;
 	}
 
@@ -146,35 +374,33 @@ const char *get_day_name(uint8_t day_of_week) {
 	return "??";
 }
 
-uint8_t gregorian_date_length_of_month(struct gregorian_date *date, uint8_t month) {
-	switch(month) {
-	case  1: return 31;
-	case  2:
-		if ((date->year & 3) == 0) {
-			if (date->year != 0) {
-				return 29;
-			}
-			if ((date->century & 3) == 0) {
-				return 29;
-			}
-		}
-		return 28;
-	case  3: return 31;
-	case  4: return 30;
-	case  5: return 31;
-	case  6: return 30;
-	case  7: return 31;
-	case  8: return 31;
-	case  9: return 30;
-	case 10: return 31;
-	case 11: return 30;
-	case 12: return 31;
-	}
-
-	// Unknown month; this should not have passed verification.
-	return 0;
+uint8_t gregorian_date_is_leap_year(struct gregorian_date *date) {
+	if ((date->year & 3) != 0) {
+		return 0;
+	}
+
+	// Year 0 of a century is only a leap year at the start of a cycle.
+	return date->year != 0 || (date->century & 3) == 0;
 }
 
+uint8_t gregorian_date_length_of_month(struct gregorian_date *date, uint8_t month) {
+	if (month == 0 || month > 12) {
+		// Unknown month; this should not have passed verification.
+		return 0;
+	}
+
+	if (month == 12) {
+		return 31;
+	}
+
+	uint8_t length = pgm_read_word(&days_before_month[month]) -
+	                 pgm_read_word(&days_before_month[month - 1]);
+	if (month == 2 && gregorian_date_is_leap_year(date)) {
+		length += 1;
+	}
+
+	return length;
+}
 
 uint8_t gregorian_date_validate(struct gregorian_date *date) {
 	// The day-of-month and day-of-week can only be validated with a known
@@ -207,33 +433,32 @@ uint8_t gregorian_date_validate(struct gregorian_date *date) {
 		date->day_of_week = 0;
 	}
 
-	// Determine the century/validate the day-of-week value.
+	// Determine the century/validate the day-of-week value:
+	// Find out which day of week the date would be in the first century
+	// of a cycle, and look up the century that shifts it to the right
+	// one.
 	date->century = 20;
-	while (1) {
-		gregorian_date_calculate_unix_date(date);
-
-		// The day-of-week _should_ be this:
-		// 1970-01-01 was a thursday
-		uint8_t unix_day_of_week = (date->unix_date + 4) % 7;
-		if (unix_day_of_week == date->day_of_week) {
-			// Yup, seems to fit.
-			break;
-		}
+	gregorian_date_calculate_unix_date(date);
 
-		// Try an other century.
-		date->century++;
+	// 1970-01-01 was a thursday
+	uint8_t shift = (date->day_of_week + 7 - (date->unix_date + 4) % 7) % 7;
+	uint8_t unshifted = (date->year == 0 && date->month <= 2);
+	uint8_t century_of_cycle = pgm_read_byte(
+		&century_of_cycle_by_day_of_week[unshifted][shift]);
 
-		if (date->century == 24) {
-			// No match has been found.
-			puts("Day of week not valid for any century.\n");
-			return 0;
-		}
+	if (century_of_cycle == 0xff) {
+		// No match has been found.
+		puts("Day of week not valid for any century.\n");
+		return 0;
 	}
 
+	date->century += century_of_cycle;
+
 	// Validate the day of month.
 	if ((date->day_of_month == 0) ||
-	    (date->day_of_month >= gregorian_date_length_of_month(date, date->month))) {
+	    (date->day_of_month > gregorian_date_length_of_month(date, date->month))) {
 		printf("Day of month is out of range: %d.\n", date->day_of_month);
+		return 0;
 	}
 
 	// Clamp the century to the one we'd like.
@@ -252,7 +477,7 @@ void gregorian_date_clamp_timespan(struct gregorian_date *date,
 
 	int8_t adjustment = (int8_t) century - (int8_t) date->century;
 
-	if (year >= date->year) {
+	if (date->year >= year) {
 		// Find minimum k such that date->century + k * 4 >= century.
 		adjustment += 3;
 	} else {
@@ -291,27 +516,14 @@ uint8_t gregorian_time_validate(struct gregorian_time *time) {
 }
 
 void gregorian_date_calculate_unix_date(struct gregorian_date *date) {
-	// The UNIX date of 2000-01-01.
-	uint32_t unix_date = (uint32_t) 365 * 30 + 7; // 30 years, 7 leap years.
+	uint32_t unix_date = UNIX_DATE_2000;
 
 	// Every full gregorian cycle (400 years) has precisely 146097 days.
 	uint8_t cycles = (date->century - 20) >> 2;
-	unix_date += (uint32_t) cycles * ((uint32_t) 365 * 400 + 97);
+	unix_date += (uint32_t) cycles * DAYS_PER_CYCLE;
 
 	// Add the number of days for the position-in-cycle.
-	switch(date->century & 3) {
-	case 3:
-		unix_date += (uint32_t) 365 * 100 + 24;
-		// fall through.
-	case 2:
-		unix_date += (uint32_t) 365 * 100 + 24;
-		// fall through.
-	case 1:
-		unix_date += (uint32_t) 365 * 100 + 25;
-		// fall through.
-	case 0:
-		break;
-	}
+	unix_date += pgm_read_dword(&days_before_century[date->century & 3]);
 
 	// Add the number of days in the completed years in this century.
 	if (date->year) {
@@ -326,8 +538,9 @@ void gregorian_date_calculate_unix_date(struct gregorian_date *date) {
 	}
 
 	// Add the lengths of all completed months.
-	for (uint8_t month = 1; month < date->month; month++) {
-		unix_date += gregorian_date_length_of_month(date, month);
+	unix_date += pgm_read_word(&days_before_month[date->month - 1]);
+	if (date->month > 2 && gregorian_date_is_leap_year(date)) {
+		unix_date += 1;
 	}
 
 	// Add the number of completed days in this month.
@@ -337,16 +550,116 @@ void gregorian_date_calculate_unix_date(struct gregorian_date *date) {
 	date->unix_date = unix_date;
 }
 
+void gregorian_date_from_unix_date(struct gregorian_date *date,
+	uint32_t unix_date) {
+
+	date->unix_date = unix_date;
+
+	// 1970-01-01 was a thursday
+	date->day_of_week = (unix_date + 4) % 7;
+
+	// Count from 1600-03-01 (the start of a cycle, with the leap day at
+	// the very end of each year); that way, the length of all months but
+	// the last one follows a fixed pattern.
+	uint32_t days = unix_date + (DAYS_PER_CYCLE - UNIX_DATE_2000 - 31 - 29);
+
+	uint8_t cycles = days / DAYS_PER_CYCLE;
+	uint32_t day_of_cycle = days % DAYS_PER_CYCLE;
+
+	// The last day of the cycle is the 4th century's leap day.
+	uint8_t century_of_cycle = (day_of_cycle - day_of_cycle / 146096) /
+	                           DAYS_PER_CENTURY;
+	uint32_t day_of_century = day_of_cycle -
+	                          (uint32_t) century_of_cycle * DAYS_PER_CENTURY;
+
+	// Likewise for each 4-year-block of the century.
+	uint8_t block = day_of_century / (365 * 4 + 1);
+	uint16_t day_of_block = day_of_century % (365 * 4 + 1);
+	uint8_t year_of_block = (day_of_block - day_of_block / 1460) / 365;
+	uint16_t day_of_year = day_of_block - 365 * year_of_block;
+
+	uint8_t year = block * 4 + year_of_block;
+
+	// Months starting with march have 31, 30, 31, 30, 31 days, then the
+	// same again for august to december, then 31, 28/29.
+	uint8_t month = (5 * day_of_year + 2) / 153;
+	date->day_of_month = day_of_year - (153 * month + 2) / 5 + 1;
+
+	// Back to years starting in january.
+	if (month < 10) {
+		month += 3;
+	} else {
+		month -= 9;
+		year += 1;
+	}
+
+	uint8_t century = 16 + cycles * 4 + century_of_cycle;
+	if (year == 100) {
+		year = 0;
+		century += 1;
+	}
+
+	date->month = month;
+	date->year = year;
+	date->century = century;
+}
+
 void gregorian_date_time_calculate_unix_time(
 	struct gregorian_date_time *datetime) {
 
-	datetime->unix_time = datetime->date.unix_date;
-	datetime->unix_time *= 24;
-	datetime->unix_time += datetime->time.hour - datetime->timezone;
-	datetime->unix_time *= 60;
-	datetime->unix_time += datetime->time.minute;
-	datetime->unix_time *= 60;
-	datetime->unix_time += datetime->time.second;
+	// 86400 = 675 * 128, so in units of 128 seconds, the local time fits
+	// in 32 bits until long after the year 9999.
+	uint32_t second_of_day = (uint32_t) datetime->time.hour * 3600 +
+	                         datetime->time.minute * 60 +
+	                         datetime->time.second;
+	uint32_t units = datetime->date.unix_date * 675 + (second_of_day >> 7);
+
+	uint8_t unix_era = units >> 25;
+	uint32_t unix_time = (units << 7) | (second_of_day & 127);
+
+	// Back to UTC.
+	int32_t offset = (int32_t) datetime->timezone * 3600;
+	uint32_t utc = unix_time - offset;
+	if (offset > 0 && utc > unix_time) {
+		unix_era--;
+	} else if (offset < 0 && utc < unix_time) {
+		unix_era++;
+	}
+
+	datetime->unix_time = utc;
+	datetime->unix_era = unix_era;
+}
 
-	// And that's it.
+void gregorian_date_time_from_unix_time(struct gregorian_date_time *datetime,
+	uint8_t unix_era, uint32_t unix_time) {
+
+	gregorian_date_time_from_unix_time_offset(datetime, unix_era, unix_time,
+		(int32_t) datetime->timezone * 3600);
+}
+
+void gregorian_date_time_from_unix_time_offset(
+	struct gregorian_date_time *datetime, uint8_t unix_era,
+	uint32_t unix_time, int32_t offset) {
+
+	datetime->unix_time = unix_time;
+	datetime->unix_era = unix_era;
+
+	// Local time, in seconds since 1970-01-01 00:00:00.
+	uint32_t local = unix_time + offset;
+	if (offset > 0 && local < unix_time) {
+		unix_era++;
+	} else if (offset < 0 && local > unix_time) {
+		unix_era--;
+	}
+
+	// As in gregorian_date_time_calculate_unix_time.
+	uint32_t units = ((uint32_t) unix_era << 25) | (local >> 7);
+	uint32_t unix_date = units / 675;
+	uint32_t second_of_day = ((units % 675) << 7) | (local & 127);
+
+	gregorian_date_from_unix_date(&datetime->date, unix_date);
+
+	datetime->time.hour = second_of_day / 3600;
+	datetime->time.minute = (second_of_day / 60) % 60;
+	datetime->time.second = second_of_day % 60;
 }
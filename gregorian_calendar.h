@@ -38,25 +38,109 @@ struct gregorian_date_time {
 	// Set in the hour before each time zone change.
 	uint8_t timezone_change_announced;
 
-	// Seconds since 1970-01-01 00:00:00 UTC, ignoring leap seconds (duh.).
+	// Seconds since 1970-01-01 00:00:00 UTC, ignoring leap seconds (duh.),
+	// modulo 2^32.
 	// This code will survive y2k38 :P
-	uint64_t unix_time;
+	uint32_t unix_time;
 
-	// The precise monotime at 1970-01-01 00:00:00 UTC.
-	int64_t epoch_monotime;
+	// The number of times unix_time has wrapped around (about every 136
+	// years; the first time in 2106).
+	uint8_t unix_era;
+
+	// The precise monotime at 1970-01-01 00:00:00 UTC, modulo 2^32.
+	// As monotimes wrap around as well, only differences to other
+	// monotimes are meaningful: The second with the UNIX time t starts
+	// at the monotime epoch_monotime + (t << 8).
+	uint32_t epoch_monotime;
 
 	// Set in the case of abnormal transmitter operation.
 	uint8_t call_bit;
 };
 
 /**
- * Contains the current date-time.
- * Is updated by the DCF processor whenever a correct minute has been
- * received;
- * Is incremented during the interrupts of the monotonic timer.
+ * The clock.
+ * Is set by the DCF processor (via gregorian_calendar_set) whenever a
+ * correct minute has been received.
+ *
+ * Only the UTC unix_time (and, after a leap second, epoch_monotime) is
+ * advanced during the interrupts of the monotonic timer; all other fields
+ * keep the values the clock has been set to. Use gregorian_calendar_now to
+ * read the current date and time, or gregorian_calendar_snapshot for the
+ * fields that the interrupts change.
  */
 extern struct gregorian_date_time current_date_time;
 
+/**
+ * The fraction of current_date_time.epoch_monotime, in 1/16ths of a
+ * monotime unit (1/4096ths of a second); between -8 and 8. The seconds of
+ * the clock start at epoch_monotime + current_epoch_fraction / 16.
+ *
+ * Kept by the phase tracker (see gregorian_calendar_move_epoch); only the
+ * seconds tick of the monotonic timer uses it.
+ */
+extern int8_t current_epoch_fraction;
+
+/**
+ * The fields of current_date_time that the interrupts of the monotonic
+ * timer change, read at one instant (see gregorian_calendar_snapshot).
+ */
+struct gregorian_calendar_snapshot {
+	// The monotime of the instant; (uint8_t) (monotime - epoch_monotime)
+	// is the fraction of the current second, in 1/256ths.
+	uint32_t monotime;
+
+	uint32_t unix_time;
+	uint8_t unix_era;
+	uint32_t epoch_monotime;
+
+	// Set during a leap second; the UNIX time is that of the second after
+	// it.
+	uint8_t in_leap_second;
+};
+
+/**
+ * Reads a consistent snapshot of the clock.
+ *
+ * Doesn't disable interrupts: the writers of the fields increment a
+ * sequence counter, and the read is retried if it has changed meanwhile.
+ * Is interrupt-safe.
+ */
+void gregorian_calendar_snapshot(struct gregorian_calendar_snapshot *snapshot);
+
+/**
+ * Sets the clock to the given date-time.
+ * Must not be called from within an ISR.
+ */
+void gregorian_calendar_set(struct gregorian_date_time *datetime);
+
+/**
+ * Moves the epoch of the clock (i.e. the start of its seconds) by the given
+ * number of 1/256ths of a second, and sets its fraction (see
+ * current_epoch_fraction).
+ * Must not be called from within an ISR.
+ */
+void gregorian_calendar_move_epoch(int8_t step, int8_t fraction);
+
+/**
+ * Advances the clock by one second.
+ * Must be called from within an ISR, at the start of each second.
+ *
+ * Respects leap second announcements by holding the UNIX time for one
+ * second.
+ */
+void gregorian_calendar_tick();
+
+/**
+ * Returns the current date-time, with all fields derived from the clock;
+ * timezone changes and leap seconds take effect at the end of the hour
+ * in which they have been announced.
+ *
+ * The result is cached until the next second starts, and remains valid
+ * until the next call.
+ * Must not be called from within an ISR.
+ */
+const struct gregorian_date_time *gregorian_calendar_now();
+
 /**
  * Returns a two-letter name of the day of week.
  */
@@ -69,6 +153,12 @@ const char *get_day_name(uint8_t day_of_week);
  */
 void gregorian_date_time_increment(struct gregorian_date_time *datetime);
 
+/**
+ * Returns 1 if the year of the given date is a leap year, 0 else.
+ * Performs no validations.
+ */
+uint8_t gregorian_date_is_leap_year(struct gregorian_date *date);
+
 /**
  * Returns the length of the given month (January = 1).
  * Performs no validations.
@@ -81,6 +171,13 @@ uint8_t gregorian_date_length_of_month(struct gregorian_date *date,
  */
 void gregorian_date_calculate_unix_date(struct gregorian_date *date);
 
+/**
+ * Sets all fields of the date (including the day of week) from the given
+ * UNIX date; the inverse of gregorian_date_calculate_unix_date.
+ */
+void gregorian_date_from_unix_date(struct gregorian_date *date,
+	uint32_t unix_date);
+
 /**
  * This method performs no validations; you must call calculate_unix_date
  * beforehand.
@@ -88,6 +185,25 @@ void gregorian_date_calculate_unix_date(struct gregorian_date *date);
 void gregorian_date_time_calculate_unix_time(
 	struct gregorian_date_time *datetime);
 
+/**
+ * Sets the date and time of the datetime from the given UNIX time, in the
+ * datetime's timezone; the inverse of
+ * gregorian_date_time_calculate_unix_time.
+ *
+ * Leap second and timezone change announcements, the epoch and the call
+ * bit are left alone.
+ */
+void gregorian_date_time_from_unix_time(struct gregorian_date_time *datetime,
+	uint8_t unix_era, uint32_t unix_time);
+
+/**
+ * As gregorian_date_time_from_unix_time, but with the given UTC offset (in
+ * seconds) instead of the datetime's timezone, which is left alone.
+ */
+void gregorian_date_time_from_unix_time_offset(
+	struct gregorian_date_time *datetime, uint8_t unix_era,
+	uint32_t unix_time, int32_t offset);
+
 /**
  * Performs range checks and calculates the century and unix date.
  * Goes as far as validating day_of_week and validating
@@ -104,6 +220,7 @@ uint8_t gregorian_date_validate(struct gregorian_date *date);
 /**
  * Initializes the gregorian calendar; sets the current date time to some
  * more or less resonable default value.
+ * Must be called after monotime_init(), with interrupts disabled.
  */
 void gregorian_calendar_init();
 
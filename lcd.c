@@ -9,8 +9,6 @@
 
 FILE lcd_stream = FDEV_SETUP_STREAM(lcd_putc, NULL, _FDEV_SETUP_WRITE);
 
-#define LCD_COLS 16
-
 /**
  * The current LCD line number ("cursor position").
  */
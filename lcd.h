@@ -7,6 +7,11 @@
 extern FILE lcd_stream;
 #define lcd (&lcd_stream)
 
+/**
+ * The number of characters per line; anything beyond is dropped.
+ */
+#define LCD_COLS 16
+
 /**
  * Initializes the LCD. Interrupts should be disabled during this call.
  */
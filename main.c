@@ -10,17 +10,27 @@
 #include "lcd.h"
 #include "led.h"
 #include "monotime.h"
+#include "oscillator.h"
+#include "phase_tracker.h"
+#include "pps.h"
+#include "temperature.h"
 #include "time_display.h"
+#include "time_estimator.h"
 
 int main() {
 	dbg_init();
-	gregorian_calendar_init();
 	led_init();
 	dcf_receiver_init();
 	monotime_init();
+	gregorian_calendar_init();
+	temperature_init();
 	lcd_init();
 
+#ifdef TIME_DISPLAY_ZONES
+	lcd_set_line_functions(display_zone_date, display_zone_time);
+#else
 	lcd_set_line_functions(display_gregorian_date, display_gregorian_time);
+#endif
 
 	sei();
 
@@ -29,22 +39,52 @@ int main() {
 	while (1) {
 		// Check whether new minute-bits are available.
 
-		uint64_t minute_bits;
-		uint32_t timestamp_monotime;
-		uint8_t poll_result = dcf_poll_data(&minute_bits,
-		                                    &timestamp_monotime);
+		struct dcf_frame frame;
+		uint8_t poll_result = dcf_poll_frame(&frame);
 
 		if (poll_result) {
-			if (!dcf_process(&minute_bits, &timestamp_monotime)) {
+			if (!dcf_process(&frame)) {
 				// The data was corrupted.
 				dbg_toggle_red();
 				puts("Decoding failure.\n");
 			} else {
 				dbg_toggle_yellow();
 				puts("Decoding success.\n");
+
+				// The marker is genuine; measure the clock
+				// against it.
+				oscillator_feed(frame.timestamp_monotime,
+					frame.timestamp_ticks);
+				time_estimator_feed(frame.timestamp_monotime,
+					frame.timestamp_ticks);
 			}
 		}
 
+		// Check the current minute while it's being received.
+		if (dcf_poll_partial(&frame)) {
+			dcf_process_partial(&frame);
+		}
+
+		// Refine the clock's phase with every second start.
+		uint32_t second_monotime, second_ticks;
+		if (dcf_poll_second(&second_monotime, &second_ticks)) {
+			phase_tracker_feed(second_monotime);
+#ifdef PPS_MEASURE
+			pps_feed_second(second_ticks);
+#endif
+		}
+
+#ifdef PPS_OUTPUT
+		// Only send the pulse per second while it can be trusted.
+		pps_update();
+#endif
+
+		// Keep track of the temperature, for the oscillator's sake.
+		int16_t temperature;
+		if (temperature_poll(&temperature)) {
+			oscillator_feed_temperature(temperature);
+		}
+
 		// Re-draw the LCD (if necessary).
 		lcd_update();
 	}
@@ -9,33 +9,662 @@
 #include "dbg.h"
 #include "gregorian_calendar.h"
 #include "lcd.h"
+#include "util.h"
+
+// Made available globally by the header.
+volatile uint32_t monotime_timer_ticks;
+
+// Incremented by the timer's interrupts whenever they change the clock, so
+// it can be read outside of them without disabling interrupts: a read is
+// retried if the sequence has changed meanwhile.
+static volatile uint8_t sequence = 0;
+
+// Seconds that start less than this (in 1/65536ths of a monotime unit; 1/16
+// unit is 244 us) after the current time are counted right away, as a
+// compare match that close could be missed.
+#define SECOND_LEAD 0x1000
+
+// The (rounded) monotime at which the last second has started.
+static uint32_t second_monotime = (uint32_t) -0x80;
+
+/**
+ * Reads the counter of Timer 1. Its 16-bit registers are accessed through
+ * a shared temporary register, which the ISRs use as well (without changing
+ * the sequence), so the read must not be interrupted.
+ */
+static inline uint16_t counter_get() {
+	uint16_t counter;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		counter = TCNT1;
+	}
+
+	return counter;
+}
+
+/**
+ * Counts the second of the clock that has just started, if any: one that
+ * has started in the last half second, or is about to within SECOND_LEAD,
+ * unless it has been counted already (the epoch may have moved meanwhile).
+ *
+ * @param monotime:
+ *     The current monotime, rounded down.
+ * @param fraction:
+ *     The fraction of the current monotime, in 1/65536ths of a unit.
+ * @returns
+ *     The time until the next second that is to be counted, in 1/65536ths
+ *     of a monotime unit; at least SECOND_LEAD.
+ */
+static int32_t second_check(uint32_t monotime, uint16_t fraction) {
+	// The time since the start of the current second (negative if it's
+	// about to start), between -128 and 128 units.
+	int32_t position =
+		((int32_t) (uint8_t) (monotime -
+		                      current_date_time.epoch_monotime) << 16) +
+		fraction - ((int32_t) current_epoch_fraction << 12);
+	if (position >= ((int32_t) 0x80 << 16)) {
+		position -= (int32_t) 0x100 << 16;
+	}
+
+	// The (rounded) monotime at which the current second has started.
+	int32_t since = ((int32_t) fraction - position + 0x8000) >> 16;
+	uint32_t start = monotime + (uint32_t) since;
+	if (position >= -SECOND_LEAD && position < ((int32_t) 0x80 << 16) &&
+	    (int32_t) (start - second_monotime) >= 0x80) {
+		second_monotime = start;
+		gregorian_calendar_tick();
+
+		// Send re-draw instruction to display.
+		lcd_redraw = 1;
+	}
+
+	int32_t until = -position;
+	while (until < SECOND_LEAD ||
+	       (int32_t) (monotime - second_monotime +
+	                  (uint32_t) (((int32_t) fraction + until + 0x8000) >>
+	                              16)) < 0x80) {
+		until += (int32_t) 0x100 << 16;
+	}
+
+	return until;
+}
+
+void monotime_epoch_set() {
+	second_monotime = current_date_time.epoch_monotime +
+	                  (current_date_time.unix_time << 8);
+	monotime_epoch_moved();
+}
+
+#ifdef PPS_OUTPUT
+
+// The states of the pulse output on OC1B: no pulse is scheduled; the
+// compare match that arms the next pulse is pending (periodic timer only);
+// the compare unit is set to raise the pin at the start of the next second;
+// the pin has been raised.
+#define PPS_IDLE 0
+#define PPS_PENDING 1
+#define PPS_ARMED 2
+#define PPS_HIGH 3
+static uint8_t pps_state = PPS_IDLE;
+
+// The width of the pulses, in Timer 1 counts; 0 for no pulses (see
+// monotime_set_pps_width). Each pulse keeps the width it has been scheduled
+// with (pps_pulse_width).
+static volatile uint32_t pps_width = 0;
+static uint32_t pps_pulse_width;
+
+// The Timer 1 counts (see monotime_timer_ticks) at which the armed pulse
+// starts, and at which the last pulse has started (if pps_sent).
+static uint32_t pps_start_ticks;
+static uint32_t pps_last_ticks;
+static uint8_t pps_sent = 0;
+
+/**
+ * Sets the compare unit to raise OC1B when the counter matches the given
+ * value, at the given time.
+ */
+static void pps_arm(uint16_t counter, uint32_t ticks) {
+	// The compare value is set first, so the old one can't raise the pin.
+	OCR1B = counter;
+	TCCR1A |= (1 << COM1B1) | (1 << COM1B0);
+
+	pps_start_ticks = ticks;
+	pps_state = PPS_ARMED;
+}
+
+/**
+ * Records that the compare unit has just raised OC1B.
+ */
+static void pps_started() {
+	pps_last_ticks = pps_start_ticks;
+	pps_sent = 1;
+	pps_state = PPS_HIGH;
+}
+
+void monotime_set_pps_width(uint32_t width) {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		pps_width = width;
+	}
+}
+
+uint8_t monotime_pps_get(uint32_t *timestamp_ticks) {
+	uint8_t sent;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		*timestamp_ticks = pps_last_ticks;
+		sent = pps_sent;
+	}
+
+	return sent;
+}
+
+/**
+ * Makes OC1B (PB2) an output that is low until the first pulse is armed.
+ */
+static void pps_init() {
+	DDRB |= (1 << PB2);
+	PORTB &= ~(1 << PB2);
+	TCCR1A |= (1 << COM1B1);
+}
+
+#endif
+
+#ifdef MONOTIME_TICKLESS
+
+// The monotime at the start of the current timer period (the last
+// overflow), with a fraction of 32 bits: in 1/65536ths of a unit
+// (period_fraction) and the 1/65536ths of those (period_subfraction).
+static volatile uint32_t period_monotime = 0;
+static volatile uint16_t period_fraction = 0;
+static uint16_t period_subfraction = 0;
+
+// The monotime per timer period, likewise: in 1/65536ths of a unit
+// (period_step) and the 1/65536ths of those (period_step_fraction).
+static volatile uint32_t period_step;
+static uint16_t period_step_fraction;
+
+// The Timer 1 counts per 1/65536th of a monotime unit, in 1/2^32ths of a
+// count (the reciprocal of period_step).
+static uint32_t unit_counts;
+
+// The above, corrected for a new frequency error; taken over at the next
+// overflow (see monotime_set_frequency_error).
+static volatile uint32_t next_period_step;
+static volatile uint16_t next_period_step_fraction;
+static volatile uint32_t next_unit_counts;
+
+#ifdef PPS_OUTPUT
+// The Timer 1 counts (see monotime_timer_ticks) at which compare A is
+// scheduled to match.
+static uint32_t compare_ticks;
+
+// Compare values this close to the counter could match before they are
+// changed (as SECOND_LEAD, in counts).
+#define PPS_LEAD ((int16_t) (MONOTIME_TIMER_HZ / 4096 + 1))
+#endif
+
+/**
+ * Calculates the monotime per timer period, and its reciprocal, for the
+ * given frequency error (see monotime_set_frequency_error).
+ */
+static void frequency_step(int32_t error, uint32_t *step,
+	uint16_t *step_fraction, uint32_t *counts) {
+
+	// The nominal monotime per timer period, in 1/2^32ths of a unit. If
+	// the clock is fast, the counts are worth less by a factor of
+	// 1 + error; the correction is calculated with fewer bits, to stay
+	// within 64 bits.
+	uint64_t nominal = ((uint64_t) 1 << 56) / MONOTIME_TIMER_HZ;
+	int64_t correction = (int64_t) (nominal >> 8) * error /
+	                     (1000000LL * MONOTIME_PPM_SCALE + error) * 256;
+	uint64_t corrected = nominal - correction;
+
+	*step = (uint32_t) (corrected >> 16);
+	*step_fraction = (uint16_t) corrected;
+	*counts = (uint32_t) (((uint64_t) 1 << 48) / *step);
+}
+
+/**
+ * Tells whether the timer has overflowed before the given counter value
+ * was latched, but the overflow ISR has not had a chance to run yet.
+ *
+ * Must be called with interrupts disabled.
+ */
+static inline uint8_t overflow_pending(uint16_t counter) {
+	return (TIFR1 & (1 << TOV1)) && (counter < MONOTIME_TIMER_PERIOD / 2);
+}
+
+/**
+ * Composes the monotime from a counter value that was latched in the
+ * current timer period (or, if overflowed is set, in the next one).
+ *
+ * Must be called with interrupts disabled, or retried if the sequence has
+ * changed.
+ *
+ * @param fraction:
+ *     The fraction of a monotime unit, in 1/65536ths, is stored here.
+ * @returns
+ *     The monotime, rounded down.
+ */
+static uint32_t compose(uint16_t counter, uint8_t overflowed,
+	uint16_t *fraction) {
+
+	// counter * period_step / 65536, in 32-bit multiplications.
+	uint32_t offset = (uint32_t) counter * (uint16_t) (period_step >> 16) +
+	                  (((uint32_t) counter * (uint16_t) period_step) >> 16);
+	if (overflowed) {
+		offset += period_step;
+	}
+	offset += period_fraction;
+
+	*fraction = (uint16_t) offset;
+	return period_monotime + (offset >> 16);
+}
+
+/**
+ * Schedules compare A for the start of the next second; with PPS_OUTPUT,
+ * the pulse is armed for it (or follows, if it has been armed already),
+ * unless one is being sent.
+ *
+ * @param ticks:
+ *     A time, in Timer 1 counts (see monotime_timer_ticks), at most a timer
+ *     period ago.
+ * @param until:
+ *     The time from then until the next second, in 1/65536ths of a
+ *     monotime unit (see second_check).
+ */
+static void second_schedule(uint32_t ticks, int32_t until) {
+	// Rounded up, so the compare matches at the start of the second, not
+	// just before it.
+	uint16_t counts = ((uint64_t) until * unit_counts + UINT32_MAX) >> 32;
+	OCR1A = (uint16_t) (ticks + counts);
+
+#ifdef PPS_OUTPUT
+	compare_ticks = ticks + counts;
+
+	if (pps_state == PPS_IDLE && pps_width) {
+		pps_pulse_width = pps_width;
+		pps_state = PPS_ARMED;
+	}
+	if (pps_state == PPS_ARMED) {
+		pps_arm(OCR1A, compare_ticks);
+	}
+#endif
+}
+
+uint32_t monotime_current_get() {
+	uint32_t result;
+	uint16_t fraction;
+	uint8_t start;
+
+	// An overflow right after the counter has been read is caught by the
+	// sequence, an earlier one that the ISR hasn't handled yet (if
+	// interrupts are disabled) by overflow_pending.
+	do {
+		start = sequence;
+		uint16_t counter = counter_get();
+		result = compose(counter, overflow_pending(counter), &fraction);
+	} while (start != sequence);
+
+	return result;
+}
+
+uint32_t monotime_ticks_get() {
+	uint32_t result;
+	uint8_t start;
+
+	do {
+		start = sequence;
+		uint16_t counter = counter_get();
+		result = monotime_timer_ticks + counter;
+		if (overflow_pending(counter)) {
+			result += MONOTIME_TIMER_PERIOD;
+		}
+	} while (start != sequence);
+
+	return result;
+}
+
+uint32_t monotime_from_counter(uint16_t counter, uint32_t *timestamp_ticks) {
+	uint8_t overflowed = overflow_pending(counter);
+	uint16_t fraction;
+
+	*timestamp_ticks = monotime_timer_ticks + counter;
+	if (overflowed) {
+		*timestamp_ticks += MONOTIME_TIMER_PERIOD;
+	}
+
+	uint32_t monotime = compose(counter, overflowed, &fraction);
+	return monotime + (fraction >> 15);
+}
+
+void monotime_init() {
+	uint32_t step, counts;
+	uint16_t step_fraction;
+	frequency_step(0, &step, &step_fraction, &counts);
+	period_step = next_period_step = step;
+	period_step_fraction = next_period_step_fraction = step_fraction;
+	unit_counts = next_unit_counts = counts;
+
+	// set clock divider to 1024; the timer runs freely (normal mode).
+	TCCR1B |= (1 << CS12) | (1 << CS10);
+	// the first second is scheduled once the first compare match has
+	// found the time.
+	OCR1A = MONOTIME_TIMER_HZ / 256;
+	// enable interrupts on overflow and on compare.
+	TIMSK1 |= (1 << TOIE1) | (1 << OCIE1A);
+
+	monotime_timer_ticks = 0;
+
+#ifdef PPS_OUTPUT
+	pps_init();
+#endif
+}
+
+void monotime_set_frequency_error(int32_t error) {
+	uint32_t step, counts;
+	uint16_t step_fraction;
+	frequency_step(error, &step, &step_fraction, &counts);
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		next_period_step = step;
+		next_period_step_fraction = step_fraction;
+		next_unit_counts = counts;
+	}
+}
+
+void monotime_epoch_moved() {
+	// The compare ISR that is due schedules from the new epoch anyway.
+	if (TIFR1 & (1 << OCF1A)) {
+		return;
+	}
+
+	uint16_t counter = TCNT1;
+#ifdef PPS_OUTPUT
+	// A pulse that is about to start can't be disarmed safely anymore.
+	if (pps_state == PPS_ARMED &&
+	    (int16_t) (OCR1B - counter) < PPS_LEAD) {
+		return;
+	}
+#endif
+
+	uint8_t overflowed = overflow_pending(counter);
+	uint16_t fraction;
+	uint32_t monotime = compose(counter, overflowed, &fraction);
+	uint32_t ticks = monotime_timer_ticks + counter;
+	if (overflowed) {
+		ticks += MONOTIME_TIMER_PERIOD;
+	}
+
+	second_schedule(ticks, second_check(monotime, fraction));
+}
+
+ISR(TIMER1_OVF_vect) {
+	monotime_timer_ticks += MONOTIME_TIMER_PERIOD;
+
+	// Advance the start of the period by the 48-bit step.
+	uint16_t subfraction = period_subfraction + period_step_fraction;
+	uint32_t fraction = (uint32_t) period_fraction +
+	                    (uint16_t) period_step +
+	                    (subfraction < period_subfraction);
+	period_subfraction = subfraction;
+	period_fraction = (uint16_t) fraction;
+	period_monotime += (period_step >> 16) + (fraction >> 16);
+
+	// A new correction only applies from the start of a period, so the
+	// monotime never runs backwards.
+	period_step = next_period_step;
+	period_step_fraction = next_period_step_fraction;
+	unit_counts = next_unit_counts;
+
+	sequence++;
+}
+
+ISR(TIMER1_COMPA_vect) {
+	uint16_t counter = TCNT1;
+	uint8_t overflowed = overflow_pending(counter);
+	uint16_t fraction;
+	uint32_t monotime = compose(counter, overflowed, &fraction);
+	uint32_t ticks = monotime_timer_ticks + counter;
+	if (overflowed) {
+		ticks += MONOTIME_TIMER_PERIOD;
+	}
+
+#ifdef PPS_OUTPUT
+	if (pps_state == PPS_ARMED) {
+		// Compare B has matched along, and raised the pin; it lowers it
+		// again after the pulse width.
+		pps_started();
+		OCR1B += (uint16_t) pps_pulse_width;
+		TCCR1A &= ~(1 << COM1B0);
+		TIFR1 = (1 << OCF1B);
+		TIMSK1 |= (1 << OCIE1B);
+	}
+#endif
+
+	// The compare match has been scheduled for the start of a second; the
+	// epoch may have moved since.
+	second_schedule(ticks, second_check(monotime, fraction));
+}
+
+#ifdef PPS_OUTPUT
+ISR(TIMER1_COMPB_vect) {
+	// The pulse has ended. The next one starts with the second that compare
+	// A is scheduled for.
+	TIMSK1 &= ~(1 << OCIE1B);
+	pps_state = PPS_IDLE;
+
+	if (pps_width) {
+		pps_pulse_width = pps_width;
+		pps_arm(OCR1A, compare_ticks);
+	}
+}
+#endif
+
+#else
 
 // Made available globally by the header.
 // Holds the number of times 1/256th of a second has passed since
 // monotime_init().
 volatile uint32_t monotime_current;
 
+// The correction of the timer period, in 1/65536ths of a Timer 1 count
+// (see monotime_set_frequency_error).
+static volatile int32_t period_correction = 0;
+
+// The fraction of a count that the periods so far have fallen short of
+// the corrected period, in 1/65536ths of a count.
+static uint16_t period_fraction = 0;
+
+// The length of the current timer period, in Timer 1 counts.
+static volatile uint16_t period_length = MONOTIME_TIMER_PERIOD;
+
+#ifdef PPS_OUTPUT
+// Compare values this close to the start of a period could have passed by
+// the time the compare ISR sets them (as SECOND_LEAD).
+#define PPS_LEAD ((int32_t) (MONOTIME_TIMER_PERIOD / 32))
+
+// The compare value at which the pending pulse starts, in the next timer
+// period.
+static uint16_t pps_counter;
+
+// The end of the raised pulse, in Timer 1 counts from the start of the
+// current timer period.
+static int32_t pps_end;
+
+/**
+ * Sets the compare unit to lower OC1B, if the raised pulse ends within the
+ * current timer period.
+ */
+static void pps_check_end() {
+	if (pps_end < period_length) {
+		OCR1B = pps_end < PPS_LEAD ? PPS_LEAD : pps_end;
+		TCCR1A &= ~(1 << COM1B0);
+		pps_state = PPS_IDLE;
+	}
+}
+#endif
+
+/**
+ * Sets compare B to the start of the next second, if it falls within the
+ * current timer period. With PPS_OUTPUT, the pulse is armed for it; if the
+ * second starts early in the next period instead, compare B is set to arm
+ * the pulse once the counter has passed halfway through this period.
+ *
+ * @param until:
+ *     The time from the start of the current period until the next second,
+ *     in 1/65536ths of a monotime unit (see second_check).
+ */
+static void second_schedule(int32_t until) {
+	if (until < ((int32_t) 2 << 16)) {
+		uint16_t start = ((uint32_t) until * period_length) >> 17;
+		OCR1B = start;
+#ifdef PPS_OUTPUT
+		// The pulse goes along (or follows, if it has been armed
+		// already).
+		if (pps_state == PPS_IDLE && pps_width) {
+			pps_pulse_width = pps_width;
+			pps_state = PPS_ARMED;
+		}
+		if (pps_state == PPS_ARMED) {
+			pps_arm(start, monotime_timer_ticks + start);
+		}
+#endif
+		TIFR1 = (1 << OCF1B);
+		TIMSK1 |= (1 << OCIE1B);
+	}
+#ifdef PPS_OUTPUT
+	else if (until < ((int32_t) 3 << 16) && pps_width &&
+	         pps_state == PPS_IDLE &&
+	         TCNT1 + PPS_LEAD < period_length / 2) {
+		// The next second starts in the first half of the next period,
+		// possibly before the compare ISR could set its compare value
+		// then. It's set halfway through this period instead, once the
+		// counter has passed it.
+		pps_counter = ((uint32_t) (until - ((int32_t) 2 << 16)) *
+		               period_length) >> 17;
+		pps_start_ticks = monotime_timer_ticks + period_length +
+		                  pps_counter;
+		pps_pulse_width = pps_width;
+		pps_state = PPS_PENDING;
+		OCR1B = period_length / 2;
+		TIFR1 = (1 << OCF1B);
+		TIMSK1 |= (1 << OCIE1B);
+	}
+#endif
+}
+
 uint32_t monotime_current_get() {
-	volatile uint32_t result;
+	uint32_t result;
+	uint8_t start;
 
-	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+	do {
+		start = sequence;
 		result = monotime_current;
-	}
+	} while (start != sequence);
 
 	return result;
 }
 
+uint32_t monotime_ticks_get() {
+	uint32_t result;
+	uint8_t start;
+
+	do {
+		start = sequence;
+		uint16_t counter = counter_get();
+		result = monotime_timer_ticks + counter;
+		if ((TIFR1 & (1 << OCF1A)) &&
+		    (counter < MONOTIME_TIMER_PERIOD / 2)) {
+			result += period_length;
+		}
+	} while (start != sequence);
+
+	return result;
+}
+
+uint32_t monotime_from_counter(uint16_t counter, uint32_t *timestamp_ticks) {
+	uint32_t monotime = monotime_current;
+	uint32_t ticks = monotime_timer_ticks;
+
+	// If the counter has been latched right after a compare match, the
+	// compare ISR has not had a chance to run yet; the counter value
+	// then belongs to the next timer period.
+	if ((TIFR1 & (1 << OCF1A)) && (counter < MONOTIME_TIMER_PERIOD / 2)) {
+		monotime += 2;
+		ticks += period_length;
+	}
+
+	*timestamp_ticks = ticks + counter;
+
+	// Each timer period spans two 1/256ths of a second.
+	if (counter >= (MONOTIME_TIMER_PERIOD / 4) * 3) {
+		monotime += 2;
+	} else if (counter >= MONOTIME_TIMER_PERIOD / 4) {
+		monotime += 1;
+	}
+
+	return monotime;
+}
+
 void monotime_init() {
 	// set clock divider to 8.
 	TCCR1B |= (1 << CS11);
 	// set compare value to 15624 to achieve a clock interval of 1/128s.
-	OCR1A = (F_CPU / 8 / 128) - 1;
+	OCR1A = MONOTIME_TIMER_PERIOD - 1;
 	// enable clear-on-timer-compare.
 	TCCR1B |= (1 << WGM12);
 	// enable interrupt-on-timer-compare.
 	TIMSK1 |= (1 << OCIE1A);
 
 	monotime_current = 0;
+	monotime_timer_ticks = 0;
+
+#ifdef PPS_OUTPUT
+	pps_init();
+#endif
+}
+
+void monotime_set_frequency_error(int32_t error) {
+	// One ppm of a period of 15625 counts is 1024/65536 counts, so at
+	// 16 MHz, the error is the correction.
+	int32_t correction = (int32_t) ((int64_t) error *
+	                                (int64_t) MONOTIME_TIMER_PERIOD / 15625);
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		period_correction = correction;
+	}
+}
+
+void monotime_epoch_moved() {
+	// The compare ISR that is due schedules from the new epoch anyway.
+	if (TIFR1 & (1 << OCF1A)) {
+		return;
+	}
+
+	uint16_t counter = TCNT1;
+#ifdef PPS_OUTPUT
+	// While a pulse is being sent, compare B is busy with its end, and the
+	// next second is far enough off for the compare ISR to schedule it. A
+	// pulse that is about to start can't be disarmed safely anymore.
+	if (pps_state == PPS_HIGH || (PINB & (1 << PB2)) ||
+	    (pps_state == PPS_ARMED &&
+	     (int16_t) (OCR1B - counter) < (int16_t) PPS_LEAD)) {
+		return;
+	}
+
+	// A pulse that has been armed for a second of the old epoch is
+	// disarmed; the pin is still low.
+	TCCR1A &= ~(1 << COM1B0);
+	pps_state = PPS_IDLE;
+#endif
+	TIMSK1 &= ~(1 << OCIE1B);
+
+	// Each timer period spans two monotime units.
+	uint32_t offset = ((uint32_t) counter << 17) / period_length;
+	int32_t until = second_check(monotime_current + (offset >> 16),
+	                             (uint16_t) offset);
+	second_schedule((int32_t) offset + until);
 }
 
 ISR(TIMER1_COMPA_vect) {
@@ -43,17 +672,59 @@ ISR(TIMER1_COMPA_vect) {
 	// a second.
 	// Overflows do not hurt us here (perfectly defined behavior).
 	monotime_current += 2;
+	monotime_timer_ticks += period_length;
+	sequence++;
 
-	// If the last byte (the sub-second fraction) of the current
-	// monotime is identical to the epoch's monotime, a new second
-	// as started. Thus, update the datetime.
-	// Don't check the last bit (since we're incrementing by two each
-	// time).
-	if ((monotime_current & 0xfe) ==
-	    (current_date_time.epoch_monotime & 0xfe)) {
-		gregorian_date_time_increment(&current_date_time);
+#ifdef PPS_OUTPUT
+	if (pps_state == PPS_HIGH) {
+		pps_end -= period_length;
+	}
+#endif
 
-		// Send re-draw instruction to display.
-		lcd_redraw = 1;
+	// The period that has just started is lengthened or shortened by the
+	// whole counts that the correction has accumulated (fractional-N), so
+	// the periods are exact on average. The compare match has just reset
+	// the counter, so it's still far below the new compare value.
+	int32_t accumulated = (int32_t) period_fraction + period_correction;
+	period_fraction = (uint16_t) accumulated;
+	period_length = MONOTIME_TIMER_PERIOD + (int16_t) (accumulated >> 16);
+	OCR1A = period_length - 1;
+
+	second_schedule(second_check(monotime_current, 0));
+
+#ifdef PPS_OUTPUT
+	if (pps_state == PPS_HIGH) {
+		pps_check_end();
 	}
+#endif
 }
+
+ISR(TIMER1_COMPB_vect) {
+#ifdef PPS_OUTPUT
+	if (pps_state == PPS_PENDING) {
+		// The interrupt stays enabled for the start of the second.
+		pps_arm(pps_counter, pps_start_ticks);
+		return;
+	}
+#endif
+
+	TIMSK1 &= ~(1 << OCIE1B);
+
+	// Each timer period spans two monotime units.
+	uint32_t offset = ((uint32_t) TCNT1 << 17) / period_length;
+	second_check(monotime_current + (offset >> 16), (uint16_t) offset);
+
+#ifdef PPS_OUTPUT
+	if (pps_state == PPS_ARMED) {
+		// The compare match has raised the pin. Its end is counted from
+		// the current period, which may have started since (if the ISR
+		// has been held up past it).
+		pps_started();
+		pps_end = (int32_t) (pps_start_ticks + pps_pulse_width -
+		                     monotime_timer_ticks);
+		pps_check_end();
+	}
+#endif
+}
+
+#endif
@@ -1,11 +1,23 @@
 // Provides a simple monotonic timer that is based on the CPU clock.
 // Uses the 16-bit Timer 1.
+//
+// By default, the timer interrupts 128 times a second to advance the clock.
+// If MONOTIME_TICKLESS is defined, it runs freely instead: the clock is
+// composed from the number of overflows and the counter on demand, and
+// only interrupts at overflows (every 4.2 s) and at the start of each
+// second.
+//
+// Either way, the calendar is advanced by a compare match at the exact
+// start of each second (see current_epoch_fraction), rather than at the
+// next period of the timer. With PPS_OUTPUT, compare B also outputs a pulse
+// at that instant (see monotime_set_pps_width).
 
 #ifndef DCF77AVR_MONOTIME_H_
 #define DCF77AVR_MONOTIME_H_
 
 #include <stdint.h>
 
+#ifndef MONOTIME_TICKLESS
 /**
  * Holds the number of seconds since clock initialization.
  * The least significant byte holds a decimal fraction.
@@ -16,14 +28,92 @@
  *
  * May be safely used only from within any ISR.
  * For use outside an ISR, use monotime_current_get().
+ *
+ * Not available with MONOTIME_TICKLESS.
  */
 extern volatile uint32_t monotime_current;
+#endif
 
 /**
- * As above, but is interrupt-safe.
+ * Returns the number of seconds since clock initialization, in 1/256ths of
+ * a second (see monotime_current).
+ *
+ * Is interrupt-safe, without disabling interrupts: the read is retried if
+ * the timer's interrupt has changed the clock meanwhile. With
+ * MONOTIME_TICKLESS, the full resolution is used.
  */
 uint32_t monotime_current_get();
 
+/**
+ * Timer 1 counts the CPU clock divided by this.
+ */
+#ifdef MONOTIME_TICKLESS
+#define MONOTIME_TIMER_PRESCALER 1024
+#else
+#define MONOTIME_TIMER_PRESCALER 8
+#endif
+
+/**
+ * Timer 1 counts at this rate.
+ */
+#define MONOTIME_TIMER_HZ (F_CPU / MONOTIME_TIMER_PRESCALER)
+
+/**
+ * The number of Timer 1 counts per timer period: 1/128th of a second, or
+ * the full range of the counter with MONOTIME_TICKLESS.
+ */
+#ifdef MONOTIME_TICKLESS
+#define MONOTIME_TIMER_PERIOD 65536UL
+#else
+#define MONOTIME_TIMER_PERIOD (MONOTIME_TIMER_HZ / 128)
+#endif
+
+/**
+ * Frequency errors are given in 1/MONOTIME_PPM_SCALE ppm.
+ */
+#define MONOTIME_PPM_SCALE 1024
+
+/**
+ * Holds the number of Timer 1 counts that have passed between
+ * monotime_init() and the start of the current timer period.
+ *
+ * These are actual counts of the CPU clock, regardless of the frequency
+ * correction (see monotime_set_frequency_error).
+ *
+ * Wraps after 2^32 counts (about 35 minutes at 16 MHz, or 76 hours with
+ * MONOTIME_TICKLESS), so it is only suitable for measuring durations.
+ *
+ * May be safely used only from within any ISR.
+ */
+extern volatile uint32_t monotime_timer_ticks;
+
+/**
+ * Returns the number of Timer 1 counts that have passed since
+ * monotime_init() (see monotime_timer_ticks), up to the current counter
+ * value.
+ *
+ * Is interrupt-safe, likewise.
+ */
+uint32_t monotime_ticks_get();
+
+/**
+ * Converts a Timer 1 counter value that was latched in the current timer
+ * period (TCNT1 or ICR1) to a precise timestamp.
+ *
+ * Must be called from within an ISR.
+ *
+ * @param counter:
+ *     The latched counter value.
+ * @param timestamp_ticks:
+ *     The timestamp is stored here, in Timer 1 counts (see
+ *     monotime_timer_ticks).
+ *
+ * @returns
+ *     The monotime of the timestamp, rounded to the nearest 1/256th of
+ *     a second.
+ */
+uint32_t monotime_from_counter(uint16_t counter, uint32_t *timestamp_ticks);
+
 /**
  * Initializes the monotinic clock and the associated timer.
  *
@@ -32,4 +122,66 @@ uint32_t monotime_current_get();
  */
 void monotime_init();
 
+/**
+ * Sets the frequency error of the CPU clock, in 1/MONOTIME_PPM_SCALE ppm;
+ * positive if the clock is fast.
+ *
+ * The timer compensates for it by varying the length of its periods by
+ * whole counts, such that they average out to the corrected length; so
+ * monotime runs at the true rate, with a jitter of one count. With
+ * MONOTIME_TICKLESS, the rate at which the counts are converted to
+ * monotime is corrected instead, from the next overflow on.
+ */
+void monotime_set_frequency_error(int32_t error);
+
+/**
+ * Reschedules the compare match for the start of the next second (and,
+ * with PPS_OUTPUT, the pulse that has been armed for it), after the epoch
+ * of the clock has moved (see gregorian_calendar_move_epoch).
+ *
+ * Must be called with interrupts disabled, and not from within an ISR.
+ */
+void monotime_epoch_moved();
+
+/**
+ * Likewise, after the clock has been set (see gregorian_calendar_set): the
+ * second that it has been set to counts as started, so it is not counted
+ * again.
+ *
+ * Must be called with interrupts disabled, and not from within an ISR.
+ */
+void monotime_epoch_set();
+
+#ifdef PPS_OUTPUT
+/**
+ * Sets the width of the pulses that are output on OC1B (PB2) at the start
+ * of each second of the clock, in Timer 1 counts; 0 to stop them. Pulses
+ * that have been scheduled already are still sent.
+ *
+ * The pin is raised and lowered by compare B itself, so the pulses are not
+ * affected by interrupt latency. With MONOTIME_TICKLESS, they start up to
+ * a count (64 us) late, as the compare value is rounded up.
+ *
+ * The pulses must end more than two timer periods (or, with
+ * MONOTIME_TICKLESS, a few milliseconds) before the next second, and be
+ * at least a millisecond wide.
+ *
+ * Only available with PPS_OUTPUT (see pps.h).
+ */
+void monotime_set_pps_width(uint32_t width);
+
+/**
+ * Asks for the time at which the last pulse has started.
+ *
+ * Only available with PPS_OUTPUT.
+ *
+ * @param timestamp_ticks:
+ *     The time is stored here, in Timer 1 counts (see
+ *     monotime_timer_ticks).
+ * @returns
+ *     1 if a pulse has been sent since initialization, 0 else.
+ */
+uint8_t monotime_pps_get(uint32_t *timestamp_ticks);
+#endif
+
 #endif
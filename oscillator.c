@@ -0,0 +1,213 @@
+#include "oscillator.h"
+
+#include <stdint.h>
+
+#include "dbg.h"
+#include "monotime.h"
+#include "oscillator_model.h"
+
+// Made available globally by the header.
+int32_t oscillator_error = 0;
+uint16_t oscillator_error_span = 0;
+uint8_t oscillator_holdover = 0;
+
+/**
+ * A minute-end marker, as passed to oscillator_feed, along with the
+ * temperature samples up to it (see temperature_sum).
+ */
+struct oscillator_marker {
+	uint32_t timestamp_monotime;
+	uint32_t timestamp_ticks;
+	uint32_t temperature_sum;
+	uint16_t temperature_count;
+};
+
+/**
+ * The marker that the measurements start from, and the one that replaces
+ * it once the span would exceed OSCILLATOR_SPAN (the first one at least
+ * half of that after it).
+ */
+static struct oscillator_marker reference;
+static struct oscillator_marker successor;
+static uint8_t reference_valid = 0;
+static uint8_t successor_valid = 0;
+
+/**
+ * The number of consecutive markers that have been ignored.
+ */
+static uint8_t rejected = 0;
+
+/**
+ * The monotime of the last marker that has been fed.
+ */
+static uint32_t last_marker_monotime;
+
+/**
+ * The sum and the number of all temperature samples (modulo 2^32 and
+ * 2^16); the average temperature between two markers is taken from the
+ * differences.
+ */
+static uint32_t temperature_sum = 0;
+static uint16_t temperature_count = 0;
+
+/**
+ * The most recent temperature sample.
+ */
+static int16_t temperature_current;
+
+/**
+ * The frequency error by temperature, as measured so far.
+ */
+static struct oscillator_model model;
+static uint8_t model_initialized = 0;
+
+/**
+ * Starts the measurements over from the given marker.
+ */
+static void restart(struct oscillator_marker *marker) {
+	reference = *marker;
+	reference_valid = 1;
+	successor_valid = 0;
+	rejected = 0;
+}
+
+/**
+ * Makes the timer compensate for the given frequency error.
+ */
+static void apply(int32_t error) {
+	oscillator_error = error;
+	monotime_set_frequency_error(error);
+}
+
+void oscillator_feed(uint32_t timestamp_monotime, uint32_t timestamp_ticks) {
+	struct oscillator_marker marker = {timestamp_monotime, timestamp_ticks,
+	                                   temperature_sum, temperature_count};
+
+	if (!model_initialized) {
+		oscillator_model_init(&model);
+		model_initialized = 1;
+	}
+
+	// For offline evaluations of the model (see tools/holdover.c).
+	printf("Oscillator trace: %lu %lu %d\n", timestamp_monotime,
+		timestamp_ticks, temperature_current);
+
+	last_marker_monotime = timestamp_monotime;
+
+	if (!reference_valid) {
+		restart(&marker);
+		return;
+	}
+
+	uint32_t elapsed = timestamp_monotime - reference.timestamp_monotime;
+	if (elapsed > ((uint32_t) OSCILLATOR_SPAN << 8) && successor_valid) {
+		reference = successor;
+		successor_valid = 0;
+		elapsed = timestamp_monotime - reference.timestamp_monotime;
+	}
+
+	if (elapsed > ((uint32_t) OSCILLATOR_SPAN << 8)) {
+		// No frames for too long.
+		restart(&marker);
+		return;
+	}
+
+	// The tick counter wraps about every 36 minutes (at 16 MHz); the
+	// monotime tells how often it has done so.
+	uint64_t ticks = timestamp_ticks - reference.timestamp_ticks;
+	uint64_t approximate = ((uint64_t) elapsed * MONOTIME_TIMER_HZ) >> 8;
+	ticks += (approximate - ticks + ((uint64_t) 1 << 31)) &
+	         ~(uint64_t) UINT32_MAX;
+
+	// Markers are whole seconds apart; the current estimate tells how
+	// many counts a second has.
+	int64_t estimated_error = (int64_t) ticks * oscillator_error /
+	                          (1000000L * MONOTIME_PPM_SCALE);
+	uint64_t corrected = ticks - estimated_error;
+	uint32_t seconds = (corrected + MONOTIME_TIMER_HZ / 2) /
+	                   MONOTIME_TIMER_HZ;
+	int32_t jitter = (int32_t) (corrected -
+	                            (uint64_t) seconds * MONOTIME_TIMER_HZ);
+
+	if (jitter > OSCILLATOR_MAX_JITTER || jitter < -OSCILLATOR_MAX_JITTER) {
+		printf("Marker is %ld counts off.\n", jitter);
+
+		// Maybe it's the reference that is off.
+		if (++rejected >= 2) {
+			restart(&marker);
+		}
+		return;
+	}
+	rejected = 0;
+
+	if (seconds == 0) {
+		return;
+	}
+
+	if (!successor_valid &&
+	    elapsed >= ((uint32_t) OSCILLATOR_SPAN << 7)) {
+		successor = marker;
+		successor_valid = 1;
+	}
+
+	int64_t nominal = (int64_t) seconds * (int64_t) MONOTIME_TIMER_HZ;
+	int32_t error = (int32_t) (((int64_t) ticks - nominal) * 1000000L *
+	                           MONOTIME_PPM_SCALE / nominal);
+
+	if (error > (int32_t) OSCILLATOR_MAX_ERROR * MONOTIME_PPM_SCALE ||
+	    error < -(int32_t) OSCILLATOR_MAX_ERROR * MONOTIME_PPM_SCALE) {
+		puts("Implausible frequency error; starting over.\n");
+		restart(&marker);
+		return;
+	}
+
+	printf("Oscillator is off by %ld/%d ppm (measured over %lu s).\n",
+		error, MONOTIME_PPM_SCALE, seconds);
+
+	// Only measurements over long spans are accurate enough to learn
+	// from, or to replace the prediction after a signal loss.
+	uint8_t long_span = (seconds >= OSCILLATOR_SPAN / 2);
+
+	uint16_t count = temperature_count - reference.temperature_count;
+	if (long_span && count) {
+		int16_t temperature = (int16_t) (
+			(temperature_sum - reference.temperature_sum) / count);
+		oscillator_model_learn(&model, temperature, error);
+	}
+
+	if (long_span || seconds >= oscillator_error_span) {
+		oscillator_error_span = seconds;
+		oscillator_holdover = 0;
+		apply(error);
+	}
+}
+
+void oscillator_feed_temperature(int16_t temperature) {
+	temperature_current = temperature;
+	temperature_sum += (uint16_t) temperature;
+	temperature_count++;
+
+	if (!reference_valid || !model_initialized) {
+		return;
+	}
+
+	if (!oscillator_holdover &&
+	    monotime_current_get() - last_marker_monotime <
+	    ((uint32_t) OSCILLATOR_HOLDOVER_DELAY << 8)) {
+		return;
+	}
+
+	int32_t error;
+	if (!oscillator_model_predict(&model, temperature, &error)) {
+		// Keep the last measurement.
+		return;
+	}
+
+	if (!oscillator_holdover) {
+		oscillator_holdover = 1;
+		puts("No markers; predicting the frequency from the "
+		     "temperature.\n");
+	}
+
+	apply(error);
+}
@@ -0,0 +1,81 @@
+// Disciplines the CPU clock, which may be off by hundreds of ppm (ceramic
+// resonators are): its frequency error is measured from the minute-end
+// markers of decoded frames, and compensated by the timer (see
+// monotime_set_frequency_error), so the clock keeps the true rate between
+// frames.
+//
+// Meanwhile, the frequency error is learned as a function of the chip's
+// temperature (see oscillator_model.h); while there are no markers, it is
+// predicted from the temperature instead.
+
+#ifndef DCF77AVR_OSCILLATOR_H_
+#define DCF77AVR_OSCILLATOR_H_
+
+#include <stdint.h>
+
+#include "monotime.h"
+
+/**
+ * Once this much time (in seconds) has passed, the frequency error is
+ * measured over at least half of it, and at most all of it.
+ *
+ * Longer spans average out more of the receiver's jitter, shorter ones
+ * follow changes of the frequency (e.g. with temperature) more quickly.
+ */
+#ifndef OSCILLATOR_SPAN
+#define OSCILLATOR_SPAN 3600
+#endif
+
+/**
+ * Larger frequency errors (in ppm) are considered to be measurement
+ * errors.
+ */
+#define OSCILLATOR_MAX_ERROR 2000
+
+/**
+ * The frequency is predicted from the temperature once there have been no
+ * markers for this many seconds.
+ */
+#define OSCILLATOR_HOLDOVER_DELAY 300
+
+/**
+ * Markers that are further than this (in Timer 1 counts) from where the
+ * current estimate expects them are ignored.
+ */
+#define OSCILLATOR_MAX_JITTER ((int32_t) (MONOTIME_TIMER_HZ / 20))
+
+/**
+ * The estimated frequency error of the CPU clock, in 1/MONOTIME_PPM_SCALE
+ * ppm; positive if the clock is fast, 0 until it has been measured.
+ */
+extern int32_t oscillator_error;
+
+/**
+ * The number of seconds over which oscillator_error has been measured.
+ */
+extern uint16_t oscillator_error_span;
+
+/**
+ * Set while oscillator_error is predicted from the temperature, rather than
+ * measured.
+ */
+extern uint8_t oscillator_holdover;
+
+/**
+ * Feeds the minute-end marker of a frame that has been decoded
+ * successfully (see struct dcf_frame), and updates the estimate and the
+ * timer's correction.
+ *
+ * Must not be called from within an ISR.
+ */
+void oscillator_feed(uint32_t timestamp_monotime, uint32_t timestamp_ticks);
+
+/**
+ * Feeds a temperature sample (see temperature_poll); predicts the
+ * frequency error from it if there have been no markers for a while.
+ *
+ * Must not be called from within an ISR.
+ */
+void oscillator_feed_temperature(int16_t temperature);
+
+#endif
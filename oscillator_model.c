@@ -0,0 +1,76 @@
+#include "oscillator_model.h"
+
+#include <stdint.h>
+
+void oscillator_model_init(struct oscillator_model *model) {
+	for (uint8_t i = 0; i < OSCILLATOR_MODEL_BINS; i++) {
+		model->bins[i].weight = 0;
+	}
+}
+
+void oscillator_model_learn(struct oscillator_model *model,
+	int16_t temperature, int32_t error) {
+
+	int16_t index = (temperature - OSCILLATOR_MODEL_MIN_TEMPERATURE) /
+	                OSCILLATOR_MODEL_BIN_WIDTH;
+	if (index < 0) {
+		index = 0;
+	} else if (index >= OSCILLATOR_MODEL_BINS) {
+		index = OSCILLATOR_MODEL_BINS - 1;
+	}
+
+	struct oscillator_model_bin *bin = &model->bins[index];
+
+	if (bin->weight < OSCILLATOR_MODEL_MAX_WEIGHT) {
+		bin->weight++;
+	}
+
+	if (bin->weight == 1) {
+		bin->error = error;
+		bin->temperature = temperature;
+	} else {
+		bin->error += (error - bin->error) / bin->weight;
+		bin->temperature += (temperature - bin->temperature) /
+		                    bin->weight;
+	}
+}
+
+uint8_t oscillator_model_predict(struct oscillator_model *model,
+	int16_t temperature, int32_t *error) {
+
+	// The nearest bins at or below and above the temperature.
+	struct oscillator_model_bin *below = 0;
+	struct oscillator_model_bin *above = 0;
+
+	for (uint8_t i = 0; i < OSCILLATOR_MODEL_BINS; i++) {
+		struct oscillator_model_bin *bin = &model->bins[i];
+		if (bin->weight == 0) {
+			continue;
+		}
+
+		if (bin->temperature <= temperature) {
+			if (!below || bin->temperature > below->temperature) {
+				below = bin;
+			}
+		} else if (!above || bin->temperature < above->temperature) {
+			above = bin;
+		}
+	}
+
+	if (!below && !above) {
+		return 0;
+	}
+
+	if (!above) {
+		*error = below->error;
+	} else if (!below) {
+		*error = above->error;
+	} else {
+		*error = below->error +
+		         (int32_t) ((int64_t) (above->error - below->error) *
+		                    (temperature - below->temperature) /
+		                    (above->temperature - below->temperature));
+	}
+
+	return 1;
+}
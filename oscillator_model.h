@@ -0,0 +1,80 @@
+// Learns the frequency error of the CPU clock as a function of its
+// temperature while it can be measured, so that it can be predicted while
+// it can't (i.e. while there is no DCF77 signal).
+//
+// Doesn't depend on the hardware, so it can be evaluated on the host with
+// logged traces (see tools/holdover.c).
+
+#ifndef DCF77AVR_OSCILLATOR_MODEL_H_
+#define DCF77AVR_OSCILLATOR_MODEL_H_
+
+#include <stdint.h>
+
+#include "temperature.h"
+
+/**
+ * The temperature range is divided into this many bins.
+ */
+#define OSCILLATOR_MODEL_BINS 32
+
+/**
+ * The width of a bin: 4 ADC steps, roughly 4 degrees.
+ */
+#define OSCILLATOR_MODEL_BIN_WIDTH (4 * TEMPERATURE_SCALE)
+
+/**
+ * The lower end of the first bin: 240 ADC steps, roughly -45 degrees for a
+ * typical chip. Temperatures outside of the range go to the first or last
+ * bin.
+ */
+#define OSCILLATOR_MODEL_MIN_TEMPERATURE (240 * TEMPERATURE_SCALE)
+
+/**
+ * New measurements are averaged into a bin with a weight of at least
+ * 1/OSCILLATOR_MODEL_MAX_WEIGHT, so the model follows aging.
+ */
+#define OSCILLATOR_MODEL_MAX_WEIGHT 16
+
+/**
+ * The measurements that have fallen into one bin, averaged.
+ */
+struct oscillator_model_bin {
+	// The frequency error, in 1/MONOTIME_PPM_SCALE ppm.
+	int32_t error;
+	// The temperature, in 1/TEMPERATURE_SCALE ADC steps.
+	int16_t temperature;
+	// The number of measurements (up to OSCILLATOR_MODEL_MAX_WEIGHT);
+	// 0 if the bin is empty.
+	uint8_t weight;
+};
+
+struct oscillator_model {
+	struct oscillator_model_bin bins[OSCILLATOR_MODEL_BINS];
+};
+
+/**
+ * Empties the model.
+ */
+void oscillator_model_init(struct oscillator_model *model);
+
+/**
+ * Adds a measurement of the frequency error (in 1/MONOTIME_PPM_SCALE ppm)
+ * at the given (average) temperature.
+ */
+void oscillator_model_learn(struct oscillator_model *model,
+	int16_t temperature, int32_t error);
+
+/**
+ * Predicts the frequency error at the given temperature, by interpolating
+ * linearly between the nearest bins on either side; beyond the outermost
+ * bins, their error is kept.
+ *
+ * @param error:
+ *     If the result is 1, the predicted error is stored here.
+ * @returns
+ *     1 on success, 0 if the model is still empty.
+ */
+uint8_t oscillator_model_predict(struct oscillator_model *model,
+	int16_t temperature, int32_t *error);
+
+#endif
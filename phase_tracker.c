@@ -0,0 +1,90 @@
+#include "phase_tracker.h"
+
+#include <stdint.h>
+
+#include "dbg.h"
+#include "gregorian_calendar.h"
+
+/**
+ * Set once the epoch in current_date_time stems from a decoded frame.
+ */
+static uint8_t locked = 0;
+
+/**
+ * The low-pass filtered phase deviation, in 1/16ths of 1/256th of a second.
+ */
+static int16_t filtered_error = 0;
+
+/**
+ * Returns the deviation of the given monotime from the nearest second
+ * start according to the given epoch, in 1/256ths of a second.
+ */
+static int16_t phase_error(uint32_t monotime, uint32_t epoch_monotime) {
+	int16_t error = (uint8_t) (monotime - epoch_monotime);
+	if (error >= 0x80) {
+		error -= 0x100;
+	}
+
+	return error;
+}
+
+uint32_t phase_tracker_align(uint32_t epoch_monotime) {
+	if (locked) {
+		struct gregorian_calendar_snapshot snapshot;
+		gregorian_calendar_snapshot(&snapshot);
+
+		int16_t error = phase_error(epoch_monotime,
+		                            snapshot.epoch_monotime);
+
+		if (error <= PHASE_TRACKER_MAX_ERROR &&
+		    error >= -PHASE_TRACKER_MAX_ERROR) {
+			// Keep the tracked phase.
+			return epoch_monotime - error;
+		}
+
+		printf("Phase jumped by %d/256 s; re-locking.\n", error);
+	}
+
+	locked = 1;
+	filtered_error = 0;
+	// The fraction belongs to the old phase, too.
+	gregorian_calendar_move_epoch(0, 0);
+
+	return epoch_monotime;
+}
+
+void phase_tracker_feed(uint32_t timestamp_monotime) {
+	if (!locked) {
+		return;
+	}
+
+	struct gregorian_calendar_snapshot snapshot;
+	gregorian_calendar_snapshot(&snapshot);
+
+	int16_t error = phase_error(timestamp_monotime,
+	                            snapshot.epoch_monotime);
+	if (error > PHASE_TRACKER_MAX_ERROR ||
+	    error < -PHASE_TRACKER_MAX_ERROR) {
+		return;
+	}
+
+	// Single-pole low-pass filter with a time constant of 8 seconds.
+	filtered_error += ((error << 4) - filtered_error + 4) >> 3;
+
+	int8_t step = 0;
+	if (filtered_error >= 8) {
+		step = 1;
+	} else if (filtered_error <= -8) {
+		step = -1;
+	}
+
+	filtered_error -= step << 4;
+
+	// The rest is kept as the epoch's fraction, so the seconds tick
+	// follows the phase more finely than the epoch can.
+	gregorian_calendar_move_epoch(step, (int8_t) filtered_error);
+}
+
+int16_t phase_tracker_offset() {
+	return filtered_error;
+}
@@ -0,0 +1,52 @@
+// Refines the sub-second phase of the clock using every second start that
+// the DCF77 receiver detects, not just the minute-end marker.
+
+#ifndef DCF77AVR_PHASE_TRACKER_H_
+#define DCF77AVR_PHASE_TRACKER_H_
+
+#include <stdint.h>
+
+/**
+ * Second starts that deviate from the tracked phase by more than this
+ * (in 1/256ths of a second) are ignored as outliers.
+ */
+#define PHASE_TRACKER_MAX_ERROR 26
+
+/**
+ * Aligns the epoch monotime of a freshly decoded frame with the tracked
+ * phase.
+ *
+ * If the tracker is locked and the new epoch is within
+ * PHASE_TRACKER_MAX_ERROR of the current sub-second phase, only the whole
+ * seconds are taken from the new epoch; the sub-second phase is kept.
+ * Otherwise, the tracker (re-)locks to the new epoch, and resets
+ * current_epoch_fraction.
+ *
+ * Must be called with the epoch that is about to be committed to
+ * current_date_time.
+ *
+ * @returns
+ *     The epoch monotime to commit.
+ */
+uint32_t phase_tracker_align(uint32_t epoch_monotime);
+
+/**
+ * Feeds the monotime of a second start, as detected by the receiver.
+ *
+ * The deviations from the current phase are low-pass filtered; whenever
+ * the filtered deviation exceeds half a monotime unit,
+ * current_date_time.epoch_monotime is moved by one unit. The rest of it
+ * becomes current_epoch_fraction.
+ *
+ * Does nothing until phase_tracker_align has been called.
+ */
+void phase_tracker_feed(uint32_t timestamp_monotime);
+
+/**
+ * Returns the low-pass filtered deviation of the second starts from the
+ * clock's phase, in 1/4096ths of a second; positive if the clock is ahead
+ * (its seconds start before those of DCF77). 0 until locked.
+ */
+int16_t phase_tracker_offset();
+
+#endif
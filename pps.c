@@ -0,0 +1,119 @@
+#include "pps.h"
+
+#include <stdint.h>
+
+#include "dbg.h"
+#include "monotime.h"
+#include "time_estimator.h"
+#include "util.h"
+
+#ifdef PPS_OUTPUT
+
+/**
+ * The second (of the monotime) in which pps_update has last run, and
+ * whether the clock has been locked then.
+ */
+static uint32_t update_second = 0;
+static uint8_t locked = 0;
+
+#ifdef PPS_MEASURE
+/**
+ * The offsets of the pulses measured so far (in microseconds), their
+ * squares, the largest absolute one, and the number of them; and the
+ * number of second starts without a pulse to measure.
+ */
+static int32_t measure_sum = 0;
+static uint64_t measure_squares = 0;
+static uint32_t measure_max = 0;
+static uint8_t measure_count = 0;
+static uint8_t measure_missed = 0;
+#endif
+
+/**
+ * Converts a pulse width in milliseconds to Timer 1 counts.
+ */
+static uint32_t width_counts(uint16_t width) {
+	return (uint32_t) width * MONOTIME_TIMER_HZ / 1000;
+}
+
+void pps_update() {
+	uint32_t second = monotime_current_get() >> 8;
+	if (second == update_second) {
+		return;
+	}
+	update_second = second;
+
+	struct time_estimate estimate;
+	uint8_t now_locked = time_estimator_get(&estimate) &&
+	                     estimate.bound <= PPS_MAX_BOUND;
+
+	if (now_locked && !locked) {
+		printf("PPS locked (bound %lu us).\n", estimate.bound);
+	} else if (!now_locked && locked) {
+		printf("PPS unlocked (bound %lu us).\n", estimate.bound);
+	}
+	locked = now_locked;
+
+	monotime_set_pps_width(width_counts(locked ? PPS_WIDTH :
+	                                    PPS_UNLOCKED_WIDTH));
+}
+
+#ifdef PPS_MEASURE
+void pps_feed_second(uint32_t timestamp_ticks) {
+	// By the time the receiver reports the second start, the pulse of the
+	// same second has started (the edge is held back until the next one);
+	// an older pulse is about a second off.
+	uint32_t pulse_ticks;
+	int32_t offset = 0;
+	uint8_t valid = monotime_pps_get(&pulse_ticks);
+	if (valid) {
+		offset = (int32_t) (timestamp_ticks - pulse_ticks);
+		valid = offset < (int32_t) (MONOTIME_TIMER_HZ / 2) &&
+		        offset > -(int32_t) (MONOTIME_TIMER_HZ / 2);
+	}
+
+	if (!valid) {
+		measure_missed++;
+	} else {
+		// Positive if the pulse has started ahead of the second.
+		offset = (int32_t) ((int64_t) offset * 1000000 /
+		                    (int32_t) MONOTIME_TIMER_HZ);
+		uint32_t magnitude = offset < 0 ? -offset : offset;
+
+		measure_sum += offset;
+		measure_squares += (uint64_t) magnitude * magnitude;
+		if (magnitude > measure_max) {
+			measure_max = magnitude;
+		}
+		measure_count++;
+	}
+
+	if (measure_count + measure_missed < PPS_MEASURE_SECONDS) {
+		return;
+	}
+
+	if (measure_count) {
+		int32_t mean = measure_sum / measure_count;
+		uint64_t mean_squares = measure_squares / measure_count;
+		uint64_t squared_mean = (uint64_t) ((int64_t) mean * mean);
+		uint32_t jitter = mean_squares > squared_mean ?
+		                  isqrt(mean_squares - squared_mean) : 0;
+
+		printf("PPS offset from the second starts: mean %ld us, "
+		       "jitter %lu us, max %lu us (%hu seconds, %hu without "
+		       "pulse).\n", mean, jitter, measure_max, measure_count,
+		       measure_missed);
+	} else {
+		printf("PPS offset from the second starts: no pulses (%hu "
+		       "seconds).\n", measure_missed);
+	}
+
+	measure_sum = 0;
+	measure_squares = 0;
+	measure_max = 0;
+	measure_count = 0;
+	measure_missed = 0;
+}
+#endif
+
+#endif
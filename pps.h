@@ -0,0 +1,71 @@
+// Outputs a pulse per second (PPS) on OC1B (PB2), for other equipment to
+// synchronize to: each pulse starts at the start of a second of the clock,
+// as set by the Timer 1 compare unit (see monotime_set_pps_width).
+//
+// The pulses are only sent while the clock is locked to DCF77, i.e. while
+// the time estimator bounds its offset to PPS_MAX_BOUND; otherwise, they are
+// suppressed, or sent with a different width so the equipment can tell.
+//
+// Only available with PPS_OUTPUT. With PPS_MEASURE, the offset of the
+// pulses from the second starts that the receiver detects is logged, too.
+
+#ifndef DCF77AVR_PPS_H_
+#define DCF77AVR_PPS_H_
+
+#include <stdint.h>
+
+/**
+ * The width of the pulses (in ms) while the clock is locked.
+ */
+#ifndef PPS_WIDTH
+#define PPS_WIDTH 100
+#endif
+
+/**
+ * The width of the pulses (in ms) while the clock is not locked; 0 to
+ * suppress them.
+ */
+#ifndef PPS_UNLOCKED_WIDTH
+#define PPS_UNLOCKED_WIDTH 0
+#endif
+
+#if PPS_WIDTH < 1 || PPS_WIDTH > 900 || PPS_UNLOCKED_WIDTH < 0 || \
+    PPS_UNLOCKED_WIDTH > 900
+#error "The pulses must be between 1 and 900 ms wide."
+#endif
+
+/**
+ * The clock is locked while the bound of its offset from DCF77 time (see
+ * struct time_estimate) is within this many microseconds.
+ */
+#define PPS_MAX_BOUND 50000
+
+/**
+ * With PPS_MEASURE, the offset of the pulses is summarized over this many
+ * second starts.
+ */
+#define PPS_MEASURE_SECONDS 60
+
+/**
+ * Decides whether the clock is locked, and sets the width of the pulses
+ * accordingly.
+ *
+ * Should be called regularly from the main loop; only does so once a
+ * second.
+ */
+void pps_update();
+
+#ifdef PPS_MEASURE
+/**
+ * Measures the last pulse against the start of a second, as detected by
+ * the receiver (see dcf_poll_second). Every PPS_MEASURE_SECONDS, the mean
+ * offset and the jitter are logged.
+ *
+ * @param timestamp_ticks:
+ *     The start of the second, in Timer 1 counts (see
+ *     monotime_timer_ticks).
+ */
+void pps_feed_second(uint32_t timestamp_ticks);
+#endif
+
+#endif
@@ -0,0 +1,77 @@
+#include "temperature.h"
+
+#include <stdint.h>
+
+#include <avr/io.h>
+
+#include "monotime.h"
+
+/**
+ * The monotime at which the last conversion has been started.
+ */
+static uint32_t conversion_monotime = 0;
+
+/**
+ * Set while a conversion is running.
+ */
+static uint8_t converting = 0;
+
+/**
+ * Set until the first conversion has been discarded; it is taken while the
+ * reference voltage settles.
+ */
+static uint8_t settling = 1;
+
+/**
+ * The low-pass filtered temperature, and whether it has been initialized.
+ */
+static int16_t filtered;
+static uint8_t filtered_valid = 0;
+
+void temperature_init() {
+	// The sensor is ADC channel 8; it must be measured against the internal
+	// 1.1 V reference.
+	ADMUX = (1 << REFS1) | (1 << REFS0) | (1 << MUX3);
+
+	// Enable the ADC; set its clock divider to 128 (125 kHz at 16 MHz).
+	ADCSRA = (1 << ADEN) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+}
+
+uint8_t temperature_poll(int16_t *temperature) {
+	if (!converting) {
+		uint32_t now = monotime_current_get();
+		if (now - conversion_monotime <
+		    ((uint32_t) TEMPERATURE_INTERVAL << 8)) {
+			return 0;
+		}
+
+		conversion_monotime = now;
+		converting = 1;
+		ADCSRA |= (1 << ADSC);
+		return 0;
+	}
+
+	if (ADCSRA & (1 << ADSC)) {
+		// Still converting.
+		return 0;
+	}
+	converting = 0;
+
+	int16_t sample = (int16_t) ADC * TEMPERATURE_SCALE;
+
+	if (settling) {
+		settling = 0;
+		return 0;
+	}
+
+	if (!filtered_valid) {
+		filtered = sample;
+		filtered_valid = 1;
+	} else {
+		// Single-pole low-pass filter with a time constant of 8 samples.
+		filtered += (sample - filtered) >> 3;
+	}
+
+	*temperature = filtered;
+	return 1;
+}
@@ -0,0 +1,36 @@
+// Samples the internal temperature sensor of the ATmega328P.
+//
+// The sensor is not calibrated: its readings are only used to tell
+// temperatures apart (roughly 1 ADC step per degree), not to display them.
+
+#ifndef DCF77AVR_TEMPERATURE_H_
+#define DCF77AVR_TEMPERATURE_H_
+
+#include <stdint.h>
+
+/**
+ * Temperatures are given in 1/TEMPERATURE_SCALE ADC steps.
+ */
+#define TEMPERATURE_SCALE 16
+
+/**
+ * A sample is taken every this many seconds.
+ */
+#define TEMPERATURE_INTERVAL 4
+
+/**
+ * Initializes the ADC for the temperature sensor.
+ */
+void temperature_init();
+
+/**
+ * Starts and completes the conversions; must be called from the main loop.
+ *
+ * @param temperature:
+ *     If the result is 1, the low-pass filtered temperature is stored here.
+ * @returns
+ *     1 if a new sample has been taken, 0 else.
+ */
+uint8_t temperature_poll(int16_t *temperature);
+
+#endif
@@ -3,16 +3,41 @@
 #include "lcd.h"
 #include "gregorian_calendar.h"
 #include "monotime.h"
+#include "time_estimator.h"
+#include "timezone.h"
 
-void display_gregorian_time() {
-	fprintf(lcd, "%02hd:%02hd:%02hd UTC%+03hd",
-	        current_date_time.time.hour,
-	        current_date_time.time.minute,
-	        current_date_time.time.second,
-	        current_date_time.timezone);
-
-	if (current_date_time.timezone_change_announced) {
-		switch (current_date_time.time.second & 3) {
+#ifdef TIME_DISPLAY_ZONES
+// The time zones shown by display_zone_date and display_zone_time.
+static const uint8_t display_zone_rules[] = {TIME_DISPLAY_ZONES};
+
+#define DISPLAY_ZONE_COUNT \
+	(sizeof(display_zone_rules) / sizeof(display_zone_rules[0]))
+
+// Each zone is shown for this many seconds.
+#define DISPLAY_ZONE_SECONDS 5
+
+static struct timezone_state display_zones[DISPLAY_ZONE_COUNT];
+static uint8_t display_zones_initialized = 0;
+#endif
+
+/**
+ * Draws the time of day, followed by a space.
+ */
+static void draw_time(const struct gregorian_date_time *datetime) {
+	fprintf(lcd, "%02hd:%02hd:%02hd ",
+	        datetime->time.hour,
+	        datetime->time.minute,
+	        datetime->time.second);
+}
+
+/**
+ * Draws a spinner during the hour before a time zone change.
+ */
+static void draw_timezone_announcement(
+	const struct gregorian_date_time *datetime) {
+
+	if (datetime->timezone_change_announced) {
+		switch (datetime->time.second & 3) {
 		case 0:
 			putc('-', lcd);
 			break;
@@ -29,30 +54,150 @@ void display_gregorian_time() {
 	}
 }
 
-void display_gregorian_date() {
-	if ((current_date_time.call_bit) &&
-	    (current_date_time.time.second & 1)) {
+/**
+ * Draws the estimated offset of the clock and its bound ("+1~4ms"), in
+ * milliseconds (or seconds, once the bound is that large), followed by
+ * the uncompensated frequency error ("+0.3ppm").
+ */
+static void draw_time_estimate() {
+	struct time_estimate estimate;
+	if (!time_estimator_get(&estimate)) {
+		fputs("no DCF77 time", lcd);
+		return;
+	}
+
+	// Offset and bound are shown in ms, or in s once the bound reaches a
+	// second; both are capped at three digits, so they take up at most 11
+	// columns.
+	int32_t offset = estimate.offset / 1000;
+	uint32_t bound = estimate.bound / 1000;
+	const char *unit = "ms";
+	if (bound >= 1000) {
+		offset /= 1000;
+		bound /= 1000;
+		unit = "s";
+	}
+	if (bound > 999) {
+		bound = 999;
+	}
+	if (offset > 999) {
+		offset = 999;
+	} else if (offset < -999) {
+		offset = -999;
+	}
+	char line[LCD_COLS + 1];
+	int length = snprintf(line, sizeof(line), "%+ld~%lu%s ", offset, bound,
+	                      unit);
+	fputs(line, lcd);
+
+	// The frequency error follows in the remaining columns; without the
+	// decimal if that doesn't fit, and not at all if that doesn't either.
+	int32_t tenths = estimate.drift * 10 / MONOTIME_PPM_SCALE;
+	char sign = '+';
+	if (tenths < 0) {
+		sign = '-';
+		tenths = -tenths;
+	}
+	char drift[LCD_COLS + 1];
+	int drift_length = snprintf(drift, sizeof(drift), "%c%ld.%ldppm", sign,
+	                            tenths / 10, tenths % 10);
+	if (length + drift_length > LCD_COLS) {
+		drift_length = snprintf(drift, sizeof(drift), "%c%ldppm", sign,
+		                        (tenths + 5) / 10);
+	}
+	if (length + drift_length <= LCD_COLS) {
+		fputs(drift, lcd);
+	}
+}
+
+/**
+ * Draws the date; blinks if the call bit is set, and shows leap second
+ * announcements.
+ * For two seconds out of ten, draws the time estimate instead.
+ */
+static void draw_date(const struct gregorian_date_time *datetime) {
+	if (datetime->time.second % 10 >= 8) {
+		draw_time_estimate();
+		return;
+	}
+
+	if ((datetime->call_bit) &&
+	    (datetime->time.second & 1)) {
 		return;
 	}
 
 	fprintf(lcd, "%s %02hd%02hd-%02hd-%02hd",
-	        get_day_name(current_date_time.date.day_of_week),
-	        current_date_time.date.century,
-	        current_date_time.date.year,
-	        current_date_time.date.month,
-	        current_date_time.date.day_of_month);
-
-	if ((current_date_time.time.leap_second_announced) &&
-	    (current_date_time.time.second & 1)) {
+	        get_day_name(datetime->date.day_of_week),
+	        datetime->date.century,
+	        datetime->date.year,
+	        datetime->date.month,
+	        datetime->date.day_of_month);
+
+	if ((datetime->time.leap_second_announced) &&
+	    (datetime->time.second & 1)) {
 		putc(' ', lcd);
 		putc('L', lcd);
 		putc('P', lcd);
 	}
 }
 
+void display_gregorian_time() {
+	const struct gregorian_date_time *now = gregorian_calendar_now();
+
+	draw_time(now);
+	fprintf(lcd, "UTC%+03hd", now->timezone);
+	draw_timezone_announcement(now);
+}
+
+void display_gregorian_date() {
+	draw_date(gregorian_calendar_now());
+}
+
+#ifdef TIME_DISPLAY_ZONES
+/**
+ * Converts the current time to the time zone that is shown at the moment.
+ */
+static struct timezone_state *display_zone_now(
+	struct gregorian_date_time *local) {
+
+	if (!display_zones_initialized) {
+		for (uint8_t i = 0; i < DISPLAY_ZONE_COUNT; i++) {
+			timezone_init(&display_zones[i], display_zone_rules[i]);
+		}
+		display_zones_initialized = 1;
+	}
+
+	const struct gregorian_date_time *now = gregorian_calendar_now();
+
+	struct timezone_state *zone = &display_zones[
+		(now->unix_time / DISPLAY_ZONE_SECONDS) % DISPLAY_ZONE_COUNT];
+	timezone_convert(zone, now, local);
+
+	return zone;
+}
+
+void display_zone_time() {
+	struct gregorian_date_time local;
+	struct timezone_state *zone = display_zone_now(&local);
+
+	draw_time(&local);
+	fputs(zone->name, lcd);
+	draw_timezone_announcement(&local);
+}
+
+void display_zone_date() {
+	struct gregorian_date_time local;
+	display_zone_now(&local);
+
+	draw_date(&local);
+}
+#endif
+
 void display_unix_time() {
-	fprintf(lcd, "UNIX: %ld",
-	        (int32_t) current_date_time.unix_time);
+	const struct gregorian_date_time *now = gregorian_calendar_now();
+
+	fprintf(lcd, "UNIX: %lu",
+	        now->unix_time);
 }
 
 void display_monotime() {
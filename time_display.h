@@ -11,6 +11,25 @@ void display_gregorian_date();
  */
 void display_gregorian_time();
 
+#ifdef TIME_DISPLAY_ZONES
+/**
+ * Draws the current date to the LCD, in one of the time zones chosen at
+ * build time (TIMEZONES in the Makefile); the zones take turns every few
+ * seconds.
+ *
+ * Only available with TIME_DISPLAY_ZONES.
+ */
+void display_zone_date();
+
+/**
+ * Draws the current time to the LCD, in the same time zone as
+ * display_zone_date.
+ *
+ * Only available with TIME_DISPLAY_ZONES.
+ */
+void display_zone_time();
+#endif
+
 /**
  * Draws the current UNIX time to the LCD.
  */
@@ -0,0 +1,205 @@
+#include "time_estimator.h"
+
+#include <stdint.h>
+
+#include "dbg.h"
+#include "monotime.h"
+#include "oscillator.h"
+#include "phase_tracker.h"
+#include "util.h"
+
+// The frequency error (in 1/MONOTIME_PPM_SCALE ppm) of one excess Timer 1
+// count per second.
+#define ERROR_PER_COUNT \
+	((int32_t) (1000000L * MONOTIME_PPM_SCALE / MONOTIME_TIMER_HZ))
+
+/**
+ * A minute-end marker, as passed to time_estimator_feed.
+ */
+struct time_estimator_marker {
+	uint32_t timestamp_monotime;
+	uint32_t timestamp_ticks;
+};
+
+/**
+ * The markers, oldest first.
+ */
+static struct time_estimator_marker history[TIME_ESTIMATOR_MARKERS];
+static uint8_t history_count = 0;
+
+/**
+ * The fitted frequency error of the CPU clock (without the oscillator's
+ * correction), and its standard deviation, in 1/MONOTIME_PPM_SCALE ppm;
+ * only valid if fit_valid.
+ */
+static int32_t fit_error;
+static uint32_t fit_error_deviation;
+static uint8_t fit_valid = 0;
+
+/**
+ * The standard deviation of the markers from the fit, in microseconds.
+ */
+static uint32_t fit_jitter = TIME_ESTIMATOR_JITTER;
+
+/**
+ * Adds a marker to the history, keeping the markers spaced.
+ */
+static void add_marker(struct time_estimator_marker *marker) {
+	if (history_count &&
+	    marker->timestamp_monotime -
+	    history[history_count - 1].timestamp_monotime >
+	    ((uint32_t) OSCILLATOR_SPAN << 8)) {
+		// Too long ago; the frequency may have changed since.
+		history_count = 0;
+	}
+
+	if (history_count >= 2 &&
+	    history[history_count - 1].timestamp_monotime -
+	    history[history_count - 2].timestamp_monotime <
+	    ((uint32_t) TIME_ESTIMATOR_SPACING << 8)) {
+		history[history_count - 1] = *marker;
+		return;
+	}
+
+	if (history_count == TIME_ESTIMATOR_MARKERS) {
+		for (uint8_t i = 1; i < TIME_ESTIMATOR_MARKERS; i++) {
+			history[i - 1] = history[i];
+		}
+		history_count--;
+	}
+
+	history[history_count++] = *marker;
+}
+
+/**
+ * Fits the Timer 1 counts between the markers and the newest one to the
+ * seconds in between: counts = seconds * MONOTIME_TIMER_HZ + a + c *
+ * seconds, where c is the excess of counts per second.
+ */
+static void fit() {
+	struct time_estimator_marker *newest = &history[history_count - 1];
+	uint8_t n = history_count;
+
+	int64_t sum_x = 0, sum_xx = 0, sum_d = 0, sum_xd = 0;
+	uint32_t x[TIME_ESTIMATOR_MARKERS];
+	int32_t d[TIME_ESTIMATOR_MARKERS];
+
+	for (uint8_t i = 0; i < n; i++) {
+		uint32_t elapsed = newest->timestamp_monotime -
+		                   history[i].timestamp_monotime;
+
+		// The counter wraps about every 36 minutes (at 16 MHz); the
+		// monotime tells how often it has done so. The markers are
+		// whole minutes apart, so even an uncorrected monotime is
+		// close enough to round to them.
+		uint64_t ticks = newest->timestamp_ticks -
+		                 history[i].timestamp_ticks;
+		uint64_t approximate = ((uint64_t) elapsed * MONOTIME_TIMER_HZ) >>
+		                       8;
+		ticks += (approximate - ticks + ((uint64_t) 1 << 31)) &
+		         ~(uint64_t) UINT32_MAX;
+
+		x[i] = (elapsed + (30 << 8)) / (60 << 8) * 60;
+		d[i] = (int32_t) ((int64_t) ticks -
+		                  (int64_t) x[i] * (int64_t) MONOTIME_TIMER_HZ);
+
+		sum_x += x[i];
+		sum_xx += (int64_t) x[i] * x[i];
+		sum_d += d[i];
+		sum_xd += (int64_t) x[i] * d[i];
+	}
+
+	int64_t denominator = n * sum_xx - sum_x * sum_x;
+	if (n < 2 || denominator <= 0) {
+		fit_valid = 0;
+		return;
+	}
+
+	// Both in 1/65536ths of a count. The numerator grows with the span of
+	// the markers (OSCILLATOR_SPAN is configurable) and with a large
+	// frequency error, so split the division to avoid overflowing the
+	// multiplication; the remainder is less than the denominator.
+	int64_t numerator = n * sum_xd - sum_x * sum_d;
+	int64_t c = numerator / denominator * 65536 +
+	            numerator % denominator * 65536 / denominator;
+	int64_t a = (sum_d * 65536 - c * sum_x) / n;
+
+	fit_error = (int32_t) (c * ERROR_PER_COUNT / 65536);
+
+	// The variance of the markers around the fit, in counts^2.
+	uint64_t variance;
+	if (n > 2) {
+		uint64_t squares = 0;
+		for (uint8_t i = 0; i < n; i++) {
+			int64_t residual = ((int64_t) d[i] * 65536 - a -
+			                    c * x[i]) / 65536;
+			squares += residual * residual;
+		}
+		variance = squares / (n - 2);
+		fit_jitter = (uint32_t) ((uint64_t) isqrt(variance) * 1000000 /
+		                         MONOTIME_TIMER_HZ);
+	} else {
+		uint64_t jitter = (uint64_t) TIME_ESTIMATOR_JITTER *
+		                  MONOTIME_TIMER_HZ / 1000000;
+		variance = jitter * jitter;
+		fit_jitter = TIME_ESTIMATOR_JITTER;
+	}
+
+	// The variance of c is variance * n / denominator.
+	fit_error_deviation = isqrt(variance * n * ERROR_PER_COUNT *
+	                            ERROR_PER_COUNT / denominator);
+	fit_valid = 1;
+
+	printf("Fitted frequency error: %ld/%d ppm, deviation %lu (%hd "
+	       "markers, jitter %lu us).\n", fit_error, MONOTIME_PPM_SCALE,
+	       fit_error_deviation, n, fit_jitter);
+}
+
+void time_estimator_feed(uint32_t timestamp_monotime,
+	uint32_t timestamp_ticks) {
+
+	struct time_estimator_marker marker = {timestamp_monotime,
+	                                       timestamp_ticks};
+	add_marker(&marker);
+	fit();
+}
+
+uint8_t time_estimator_get(struct time_estimate *estimate) {
+	if (!history_count) {
+		return 0;
+	}
+
+	uint32_t age = (monotime_current_get() -
+	                history[history_count - 1].timestamp_monotime) >> 8;
+
+	int32_t drift = 0;
+	uint32_t drift_deviation = (uint32_t) TIME_ESTIMATOR_UNKNOWN_DRIFT *
+	                           MONOTIME_PPM_SCALE;
+	if (fit_valid) {
+		drift = fit_error - oscillator_error;
+		drift_deviation = fit_error_deviation;
+	}
+
+	// The phase tracker follows the second starts for as long as there
+	// are any; the drift takes over from the last marker on.
+	int32_t offset = ((int32_t) phase_tracker_offset() * 15625) >> 6;
+	offset += (int32_t) ((int64_t) drift * age / MONOTIME_PPM_SCALE);
+
+	uint64_t drift_uncertainty = (uint64_t) drift_deviation * age /
+	                             MONOTIME_PPM_SCALE;
+	uint64_t deviation = isqrt((uint64_t) fit_jitter * fit_jitter +
+	                           drift_uncertainty * drift_uncertainty);
+
+	// The clock only has a resolution of 1/256th of a second.
+	uint64_t bound = (offset < 0 ? -(int64_t) offset : offset) +
+	                 3 * deviation +
+	                 (uint64_t) TIME_ESTIMATOR_WANDER * age +
+	                 1000000 / 512;
+
+	estimate->offset = offset;
+	estimate->drift = drift;
+	estimate->bound = bound > UINT32_MAX ? UINT32_MAX : (uint32_t) bound;
+	estimate->age = age;
+
+	return 1;
+}
@@ -0,0 +1,80 @@
+// Estimates how far the clock may be off from DCF77 time, especially while
+// there is no signal: from a short history of minute-end markers, the
+// frequency error that remains after the oscillator's correction is fitted
+// by least squares, along with its uncertainty.
+
+#ifndef DCF77AVR_TIME_ESTIMATOR_H_
+#define DCF77AVR_TIME_ESTIMATOR_H_
+
+#include <stdint.h>
+
+/**
+ * The number of markers in the history.
+ */
+#define TIME_ESTIMATOR_MARKERS 8
+
+/**
+ * Markers are kept at least this many seconds apart (a new marker replaces
+ * the newest one until then), so the history spans a longer time.
+ */
+#define TIME_ESTIMATOR_SPACING 300
+
+/**
+ * The jitter of the markers (in microseconds) that is assumed until it can
+ * be measured.
+ */
+#define TIME_ESTIMATOR_JITTER 5000
+
+/**
+ * The uncertainty of the frequency (in ppm) that is assumed until it can be
+ * measured.
+ */
+#define TIME_ESTIMATOR_UNKNOWN_DRIFT 100
+
+/**
+ * How far the frequency may wander (in ppm) without a signal, e.g. with
+ * the temperature, beyond what the oscillator predicts.
+ */
+#define TIME_ESTIMATOR_WANDER 2
+
+/**
+ * The estimated state of the clock.
+ */
+struct time_estimate {
+	// The offset of the clock from DCF77 time, in microseconds; positive if
+	// the clock is ahead.
+	int32_t offset;
+
+	// The rate at which the offset changes, i.e. the frequency error that
+	// the timer doesn't compensate for, in 1/MONOTIME_PPM_SCALE ppm.
+	int32_t drift;
+
+	// The clock is within this many microseconds of DCF77 time, with high
+	// confidence (three standard deviations, plus the clock's resolution
+	// and the possible wander of the frequency).
+	uint32_t bound;
+
+	// The number of seconds since the last marker.
+	uint32_t age;
+};
+
+/**
+ * Feeds the minute-end marker of a frame that has been decoded
+ * successfully (see struct dcf_frame).
+ *
+ * Must not be called from within an ISR.
+ */
+void time_estimator_feed(uint32_t timestamp_monotime,
+	uint32_t timestamp_ticks);
+
+/**
+ * Estimates the state of the clock at the current time.
+ *
+ * Must not be called from within an ISR.
+ *
+ * @returns
+ *     1 on success, 0 if there has been no marker yet.
+ */
+uint8_t time_estimator_get(struct time_estimate *estimate);
+
+#endif
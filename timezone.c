@@ -0,0 +1,201 @@
+#include "timezone.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <avr/pgmspace.h>
+
+#include "dbg.h"
+
+/**
+ * A change of the UTC offset that takes place once a year.
+ */
+struct timezone_transition {
+	uint8_t month;
+	// 1-4: on the n-th day_of_week of the month; 5: on the last one.
+	uint8_t week;
+	// Sunday = 0.
+	uint8_t day_of_week;
+	// The local time of day before the transition, in hours.
+	uint8_t hour;
+};
+
+/**
+ * Describes the standard (0) and daylight saving (1) time of a time zone.
+ */
+struct timezone_rule {
+	char name[2][TIMEZONE_NAME_LENGTH + 1];
+	// The UTC offsets, in quarter hours.
+	int8_t offset[2];
+	// transition[i] switches to offset[i]; unused if both offsets are
+	// equal.
+	struct timezone_transition transition[2];
+};
+
+// The daylight saving time rules of the EU, the US and Australia.
+#define EU_RULE(hour) {{10, 5, 0, (hour) + 1}, {3, 5, 0, (hour)}}
+#define US_RULE {{11, 1, 0, 2}, {3, 2, 0, 2}}
+#define AU_RULE {{4, 1, 0, 3}, {10, 1, 0, 2}}
+#define NO_RULE {{0, 0, 0, 0}, {0, 0, 0, 0}}
+
+static const struct timezone_rule timezone_rules[TIMEZONE_COUNT] PROGMEM = {
+	[TIMEZONE_UTC] =         {{"UTC", "UTC"},   {0, 0},     NO_RULE},
+	[TIMEZONE_WET] =         {{"WET", "WEST"},  {0, 4},     EU_RULE(1)},
+	[TIMEZONE_CET] =         {{"CET", "CEST"},  {4, 8},     EU_RULE(2)},
+	[TIMEZONE_EET] =         {{"EET", "EEST"},  {8, 12},    EU_RULE(3)},
+	[TIMEZONE_MSK] =         {{"MSK", "MSK"},   {12, 12},   NO_RULE},
+	[TIMEZONE_IST] =         {{"IST", "IST"},   {22, 22},   NO_RULE},
+	[TIMEZONE_US_EASTERN] =  {{"EST", "EDT"},   {-20, -16}, US_RULE},
+	[TIMEZONE_US_CENTRAL] =  {{"CST", "CDT"},   {-24, -20}, US_RULE},
+	[TIMEZONE_US_MOUNTAIN] = {{"MST", "MDT"},   {-28, -24}, US_RULE},
+	[TIMEZONE_US_PACIFIC] =  {{"PST", "PDT"},   {-32, -28}, US_RULE},
+	[TIMEZONE_AU_EASTERN] =  {{"AEST", "AEDT"}, {40, 44},   AU_RULE},
+};
+
+void timezone_init(struct timezone_state *zone, uint8_t rule) {
+	zone->rule = rule;
+	zone->offset = 0;
+	zone->name[0] = '\0';
+
+	// Nothing is valid until the first conversion.
+	zone->valid_from = 0;
+	zone->valid_length = 0;
+}
+
+/**
+ * Returns the UNIX time (modulo 2^32) of the given transition in the given
+ * year.
+ */
+static uint32_t transition_time(struct timezone_rule *rule, uint8_t to,
+	uint16_t year) {
+
+	struct timezone_transition *transition = &rule->transition[to];
+
+	struct gregorian_date date;
+	date.century = year / 100;
+	date.year = year % 100;
+	date.month = transition->month;
+	date.day_of_month = 1;
+	gregorian_date_calculate_unix_date(&date);
+
+	// Find the first matching day of week of the month (1970-01-01 was a
+	// thursday), then go on by whole weeks; week 5 may be too far.
+	uint8_t day = (transition->day_of_week + 7 - (date.unix_date + 4) % 7);
+	day %= 7;
+	day += 7 * (transition->week - 1);
+	if (day >= gregorian_date_length_of_month(&date, date.month)) {
+		day -= 7;
+	}
+
+	uint32_t unix_time = (date.unix_date + day) * 86400;
+	unix_time += (uint32_t) transition->hour * 3600;
+
+	// The hour is given in the local time before the transition.
+	unix_time -= (int32_t) rule->offset[to ^ 1] * 900;
+
+	return unix_time;
+}
+
+/**
+ * Determines the offset at the given UNIX time, and until when it is
+ * valid.
+ */
+static void timezone_update(struct timezone_state *zone, uint8_t unix_era,
+	uint32_t unix_time) {
+
+	struct timezone_rule rule;
+	memcpy_P(&rule, &timezone_rules[zone->rule], sizeof(rule));
+
+	// Not set before the first evaluation (see timezone_init).
+	uint8_t evaluated = (zone->valid_length != 0);
+	uint8_t state = 0;
+
+	if (rule.offset[0] == rule.offset[1]) {
+		// No transitions at all.
+		zone->valid_from = unix_time;
+		zone->valid_length = UINT32_MAX;
+	} else {
+		struct gregorian_date_time utc;
+		gregorian_date_time_from_unix_time_offset(&utc, unix_era,
+			unix_time, 0);
+		uint16_t year = utc.date.century * 100 + utc.date.year;
+
+		// Among the transitions of the previous, the current and the
+		// next year, find the last one up to unix_time and the first
+		// one after it. They are all close to unix_time, so their
+		// distances are not affected by the wrap-around.
+		int32_t last = INT32_MIN;
+		int32_t next = INT32_MAX;
+
+		for (uint16_t y = year - 1; y <= year + 1; y++) {
+			for (uint8_t to = 0; to < 2; to++) {
+				int32_t distance = (int32_t) (
+					transition_time(&rule, to, y) - unix_time);
+
+				if (distance <= 0 && distance > last) {
+					last = distance;
+					state = to;
+				} else if (distance > 0 && distance < next) {
+					next = distance;
+				}
+			}
+		}
+
+		zone->valid_from = unix_time + last;
+		zone->valid_length = (uint32_t) next - (uint32_t) last;
+	}
+
+	int32_t offset = (int32_t) rule.offset[state] * 900;
+	if (evaluated && offset != zone->offset) {
+		printf("Time zone %hd: offset %ld s from now on.\n", zone->rule,
+			offset);
+	}
+
+	zone->offset = offset;
+	memcpy(zone->name, rule.name[state], sizeof(zone->name));
+}
+
+int32_t timezone_offset(struct timezone_state *zone, uint8_t unix_era,
+	uint32_t unix_time) {
+
+	if ((uint32_t) (unix_time - zone->valid_from) >= zone->valid_length) {
+		timezone_update(zone, unix_era, unix_time);
+	}
+
+	return zone->offset;
+}
+
+void timezone_convert(struct timezone_state *zone,
+	const struct gregorian_date_time *utc,
+	struct gregorian_date_time *local) {
+
+	uint32_t unix_time = utc->unix_time;
+	uint8_t unix_era = utc->unix_era;
+
+	uint8_t leap_second = (utc->time.second == 60);
+	if (leap_second) {
+		// Convert the second before it.
+		if (unix_time == 0) {
+			unix_era--;
+		}
+		unix_time--;
+	}
+
+	int32_t offset = timezone_offset(zone, unix_era, unix_time);
+	gregorian_date_time_from_unix_time_offset(local, unix_era, unix_time,
+		offset);
+
+	if (leap_second) {
+		local->time.second = 60;
+		local->unix_time = utc->unix_time;
+		local->unix_era = utc->unix_era;
+	}
+
+	// Announce the transition during the hour before it (as DCF77 does).
+	local->timezone_change_announced =
+		zone->valid_length != UINT32_MAX &&
+		(zone->valid_from + zone->valid_length - unix_time) <= 3600;
+	local->time.leap_second_announced = utc->time.leap_second_announced;
+	local->epoch_monotime = utc->epoch_monotime;
+	local->call_bit = utc->call_bit;
+}
@@ -0,0 +1,79 @@
+// Converts UTC to the local time of arbitrary time zones, as described by
+// compact daylight saving time rules.
+//
+// The rules are only evaluated when a transition is passed; in between,
+// the conversion takes a single compare and add.
+
+#ifndef DCF77AVR_TIMEZONE_H_
+#define DCF77AVR_TIMEZONE_H_
+
+#include <stdint.h>
+
+#include "gregorian_calendar.h"
+
+// The known time zones (indices into the rule table).
+#define TIMEZONE_UTC 0
+#define TIMEZONE_WET 1           // Western Europe (London, Lisbon)
+#define TIMEZONE_CET 2           // Central Europe (Berlin, Paris)
+#define TIMEZONE_EET 3           // Eastern Europe (Helsinki, Athens)
+#define TIMEZONE_MSK 4           // Moscow
+#define TIMEZONE_IST 5           // India
+#define TIMEZONE_US_EASTERN 6
+#define TIMEZONE_US_CENTRAL 7
+#define TIMEZONE_US_MOUNTAIN 8
+#define TIMEZONE_US_PACIFIC 9
+#define TIMEZONE_AU_EASTERN 10   // Sydney, Melbourne
+#define TIMEZONE_COUNT 11
+
+/**
+ * The maximum length of a time zone abbreviation.
+ */
+#define TIMEZONE_NAME_LENGTH 4
+
+/**
+ * The state of a single time zone; there may be any number of these.
+ */
+struct timezone_state {
+	// The index of the rule (one of the TIMEZONE_* values).
+	uint8_t rule;
+
+	// The current UTC offset, in seconds, and the abbreviation that goes
+	// with it.
+	int32_t offset;
+	char name[TIMEZONE_NAME_LENGTH + 1];
+
+	// The offset is valid for UNIX times t with
+	// t - valid_from < valid_length (modulo 2^32), i.e. from the last
+	// transition up to (excluding) the next one.
+	uint32_t valid_from;
+	uint32_t valid_length;
+};
+
+/**
+ * Initializes the time zone with the given rule.
+ * The offset is determined by the first conversion.
+ */
+void timezone_init(struct timezone_state *zone, uint8_t rule);
+
+/**
+ * Returns the UTC offset (in seconds) of the time zone at the given UNIX
+ * time.
+ *
+ * Only evaluates the rule if a transition has been passed (or the time has
+ * jumped) since the last call.
+ */
+int32_t timezone_offset(struct timezone_state *zone, uint8_t unix_era,
+	uint32_t unix_time);
+
+/**
+ * Converts a UTC date-time (as returned by gregorian_calendar_now) to the
+ * local date and time of the time zone.
+ *
+ * The timezone field of the result is left alone, as it can't represent
+ * all offsets; use zone->name instead. A leap second stays second 60.
+ */
+void timezone_convert(struct timezone_state *zone,
+	const struct gregorian_date_time *utc,
+	struct gregorian_date_time *local);
+
+#endif
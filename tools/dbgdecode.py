@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+"""
+Expands the binary debug records of a firmware built with DBGLOG=binary
+(see dbg.h) back to text.
+
+The format strings are not sent by the target; they are looked up by their
+flash address in the ELF file of the firmware that is running.
+
+Usage: dbgdecode.py dcf77avr.elf < /dev/ttyUSB0
+"""
+
+import re
+import struct
+import sys
+
+RECORD_SYNC = 0xa5
+
+# The size of the arguments of printf conversions on AVR, by length
+# modifier.
+SIZES = {'hh': 1, 'h': 2, None: 2, 'l': 4, 'll': 8}
+
+# printf conversions, as used in the firmware; %B is a 64-bit word in
+# binary (see dbg_print_binary_64).
+CONVERSION = re.compile(
+    r'%([-+ #0]*[0-9]*(?:\.[0-9]+)?)(hh|h|ll|l)?([diuxXocB%])')
+
+
+def read_flash(elf_path):
+    """
+    Returns the contents of the .text section (which includes the PROGMEM
+    data), and its address.
+    """
+    with open(elf_path, 'rb') as f:
+        elf = f.read()
+
+    if elf[:4] != b'\x7fELF' or elf[4] != 1:
+        raise ValueError('not a 32-bit ELF file')
+
+    shoff, = struct.unpack_from('<I', elf, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from('<HHH', elf, 0x2e)
+
+    def section(index):
+        # name, type, flags, addr, offset, size
+        return struct.unpack_from('<IIIIII', elf, shoff + index * shentsize)
+
+    names_offset = section(shstrndx)[4]
+    for index in range(shnum):
+        name, _, _, addr, offset, size = section(index)
+        end = elf.index(b'\0', names_offset + name)
+        if elf[names_offset + name:end] == b'.text':
+            return elf[offset:offset + size], addr
+
+    raise ValueError('no .text section')
+
+
+class Dictionary:
+    """
+    Maps flash addresses to format strings.
+    """
+
+    def __init__(self, flash, base):
+        self.flash = flash
+        self.base = base
+
+    def lookup(self, address):
+        offset = address - self.base
+        if offset < 0 or offset >= len(self.flash):
+            return None
+
+        end = self.flash.find(b'\0', offset)
+        if end < 0:
+            return None
+
+        try:
+            return self.flash[offset:end].decode('ascii')
+        except UnicodeDecodeError:
+            return None
+
+
+def parse_arguments(payload):
+    """
+    Splits the payload into the raw arguments, or returns None if it's
+    malformed.
+    """
+    arguments = []
+    pos = 0
+    while pos < len(payload):
+        size = payload[pos]
+        if size == 0 or pos + 1 + size > len(payload):
+            return None
+        arguments.append(payload[pos + 1:pos + 1 + size])
+        pos += 1 + size
+    return arguments
+
+
+def expand(fmt, arguments):
+    """
+    Formats the raw arguments like printf, or returns None if they don't
+    match the format string.
+    """
+    conversions = [m for m in CONVERSION.finditer(fmt) if m.group(3) != '%']
+    if len(conversions) != len(arguments):
+        return None
+
+    remaining = iter(arguments)
+
+    def convert(match):
+        flags, length, conversion = match.groups()
+        if conversion == '%':
+            return '%'
+
+        raw = next(remaining)
+        # Arguments narrower than the conversion (e.g. an uint8_t for %hd)
+        # have been promoted by printf; the firmware passes them unsigned.
+        signed = conversion in 'di' and len(raw) >= SIZES[length]
+        value = int.from_bytes(raw, 'little', signed=signed)
+
+        if conversion == 'B':
+            return format(value, '0%db' % (8 * len(raw)))
+        if conversion == 'c':
+            return chr(value & 0xff)
+        if conversion == 'u':
+            conversion = 'd'
+        return ('%' + flags + conversion) % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def decode(stream, dictionary, out):
+    buf = b''
+    while True:
+        chunk = stream.read(1)
+        if not chunk:
+            return
+        buf += chunk
+
+        while True:
+            start = buf.find(bytes([RECORD_SYNC]))
+            if start < 0:
+                buf = b''
+                break
+            buf = buf[start:]
+
+            if len(buf) < 4 or len(buf) < 4 + buf[3]:
+                # Wait for the rest of the record.
+                break
+
+            address = buf[1] | (buf[2] << 8)
+            length = buf[3]
+            arguments = parse_arguments(buf[4:4 + length])
+
+            if address == 0:
+                fmt = '[%u debug records dropped]\n'
+            else:
+                fmt = dictionary.lookup(address)
+
+            text = None
+            if fmt is not None and arguments is not None:
+                text = expand(fmt, arguments)
+
+            if text is None:
+                # Not a record after all (or a corrupted one); resync.
+                buf = buf[1:]
+                continue
+
+            out.write(text)
+            out.flush()
+            buf = buf[4 + length:]
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.stderr.write(__doc__.lstrip())
+        sys.exit(1)
+
+    flash, base = read_flash(sys.argv[1])
+    decode(sys.stdin.buffer, Dictionary(flash, base), sys.stdout)
+
+
+if __name__ == '__main__':
+    main()
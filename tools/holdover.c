@@ -0,0 +1,224 @@
+// Evaluates the oscillator's temperature model (oscillator_model.c) on the
+// host, with the "Oscillator trace" lines of a debug log (see
+// oscillator_feed).
+//
+// The trace is split into chunks of OSCILLATOR_SPAN / 2 seconds (the
+// shortest span that the firmware learns from), and walked through in time
+// order: each chunk's frequency error is predicted before it is learned.
+// From each chunk on, the signal is assumed to be lost for a day; the time
+// error that the clock would have accumulated with the model as it was at
+// that point is reported, along with the error of keeping the last
+// measurement instead.
+//
+// Usage: make holdover TRACE=<log>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "monotime.h"
+#include "oscillator.h"
+#include "oscillator_model.h"
+
+#define DAY 86400
+
+struct marker {
+	uint32_t timestamp_monotime;
+	uint32_t timestamp_ticks;
+	int16_t temperature;
+};
+
+struct chunk {
+	uint32_t seconds;
+	// In 1/MONOTIME_PPM_SCALE ppm.
+	int32_t error;
+	int16_t temperature;
+};
+
+static struct marker *markers = 0;
+static size_t marker_count = 0;
+
+static struct chunk *chunks = 0;
+static size_t chunk_count = 0;
+
+static void read_trace(FILE *file) {
+	static const char tag[] = "Oscillator trace: ";
+	size_t capacity = 0;
+	char line[256];
+
+	while (fgets(line, sizeof(line), file)) {
+		char *start = strstr(line, tag);
+		unsigned long monotime, ticks;
+		int temperature;
+		if (!start || sscanf(start + sizeof(tag) - 1, "%lu %lu %d",
+		                     &monotime, &ticks, &temperature) != 3) {
+			continue;
+		}
+
+		if (marker_count == capacity) {
+			capacity = capacity ? 2 * capacity : 1024;
+			markers = realloc(markers, capacity * sizeof(*markers));
+		}
+		markers[marker_count].timestamp_monotime = monotime;
+		markers[marker_count].timestamp_ticks = ticks;
+		markers[marker_count].temperature = temperature;
+		marker_count++;
+	}
+}
+
+/**
+ * Returns the Timer 1 counts between two consecutive markers; the
+ * monotime tells how often the counter has wrapped in between.
+ */
+static uint64_t ticks_between(struct marker *from, struct marker *to) {
+	uint32_t elapsed = to->timestamp_monotime - from->timestamp_monotime;
+	uint64_t ticks = to->timestamp_ticks - from->timestamp_ticks;
+	uint64_t approximate = ((uint64_t) elapsed * MONOTIME_TIMER_HZ) >> 8;
+	ticks += (approximate - ticks + ((uint64_t) 1 << 31)) &
+	         ~(uint64_t) UINT32_MAX;
+	return ticks;
+}
+
+static void split_chunks() {
+	chunks = malloc((marker_count + 1) * sizeof(*chunks));
+
+	size_t first = 0;
+	while (first < marker_count) {
+		uint64_t ticks = 0;
+		uint32_t monotime = 0;
+		int32_t temperature_sum = markers[first].temperature;
+		size_t last = first;
+
+		while (last + 1 < marker_count &&
+		       monotime < ((uint32_t) OSCILLATOR_SPAN << 7)) {
+			ticks += ticks_between(&markers[last], &markers[last + 1]);
+			monotime += markers[last + 1].timestamp_monotime -
+			            markers[last].timestamp_monotime;
+			temperature_sum += markers[last + 1].temperature;
+			last++;
+		}
+
+		if (monotime < ((uint32_t) OSCILLATOR_SPAN << 7)) {
+			break;
+		}
+
+		// The disciplined monotime is close enough to the true time to
+		// round to whole seconds.
+		struct chunk *chunk = &chunks[chunk_count++];
+		chunk->seconds = (monotime + 0x80) >> 8;
+		int64_t nominal = (int64_t) chunk->seconds * MONOTIME_TIMER_HZ;
+		chunk->error = (int32_t) (((int64_t) ticks - nominal) * 1000000 *
+		                          MONOTIME_PPM_SCALE / nominal);
+		chunk->temperature = temperature_sum / (int32_t) (last - first + 1);
+
+		first = last;
+	}
+}
+
+/**
+ * Converts a frequency error (in 1/MONOTIME_PPM_SCALE ppm) over the given
+ * number of seconds to a time error, in milliseconds.
+ */
+static double time_error(int64_t error, uint32_t seconds) {
+	return (double) error * seconds / MONOTIME_PPM_SCALE / 1000.0;
+}
+
+int main() {
+	read_trace(stdin);
+	split_chunks();
+
+	printf("%zu markers, %zu chunks of at least %d s.\n", marker_count,
+		chunk_count, OSCILLATOR_SPAN / 2);
+
+	struct oscillator_model model;
+	oscillator_model_init(&model);
+	if (chunk_count) {
+		oscillator_model_learn(&model, chunks[0].temperature,
+			chunks[0].error);
+	}
+
+	double squares = 0;
+	size_t predicted = 0;
+
+	// Indexed by whether the model has been learning for a day at the
+	// start.
+	size_t days[2] = {0, 0};
+	double model_sum[2] = {0, 0}, model_max[2] = {0, 0};
+	double last_sum[2] = {0, 0}, last_max[2] = {0, 0};
+	uint32_t learned = chunks ? chunks[0].seconds : 0;
+
+	for (size_t i = 1; i < chunk_count; i++) {
+		int32_t last = chunks[i - 1].error;
+
+		// Predict this chunk.
+		int32_t error;
+		if (oscillator_model_predict(&model, chunks[i].temperature,
+		                             &error)) {
+			double deviation = (double) (error - chunks[i].error) /
+			                   MONOTIME_PPM_SCALE;
+			squares += deviation * deviation;
+			predicted++;
+		}
+
+		// Lose the signal for a day, from this chunk on.
+		double model_ms = 0, last_ms = 0;
+		uint32_t seconds = 0;
+		size_t k;
+		for (k = i; k < chunk_count && seconds < DAY; k++) {
+			struct chunk *chunk = &chunks[k];
+			if (!oscillator_model_predict(&model, chunk->temperature,
+			                              &error)) {
+				error = last;
+			}
+			model_ms += time_error(error - chunk->error, chunk->seconds);
+			last_ms += time_error(last - chunk->error, chunk->seconds);
+			seconds += chunk->seconds;
+		}
+
+		if (seconds >= DAY) {
+			uint8_t trained = (learned >= DAY);
+			days[trained]++;
+			model_ms = fabs(model_ms);
+			last_ms = fabs(last_ms);
+			model_sum[trained] += model_ms;
+			last_sum[trained] += last_ms;
+			model_max[trained] = fmax(model_ms, model_max[trained]);
+			last_max[trained] = fmax(last_ms, last_max[trained]);
+		}
+
+		oscillator_model_learn(&model, chunks[i].temperature,
+			chunks[i].error);
+		learned += chunks[i].seconds;
+	}
+
+	if (predicted) {
+		printf("Frequency predicted for %zu chunks; RMS error %.2f "
+		       "ppm.\n", predicted, sqrt(squares / predicted));
+	}
+
+	if (!days[0] && !days[1]) {
+		puts("The trace is shorter than a day.");
+	}
+
+	static const char *titles[2] = {
+		"during the first day of learning",
+		"after the first day of learning",
+	};
+	for (uint8_t trained = 0; trained < 2; trained++) {
+		size_t n = days[trained];
+		if (!n) {
+			continue;
+		}
+		printf("Time error after a day without signal, %s (%zu "
+		       "starts):\n"
+		       "  with the model:            mean %.0f ms, max %.0f ms\n"
+		       "  with the last measurement: mean %.0f ms, max %.0f ms\n",
+		       titles[trained], n, model_sum[trained] / n,
+		       model_max[trained], last_sum[trained] / n,
+		       last_max[trained]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,9 @@
+// Stand-in for the AVR interrupt macros, for the host tests: an ISR is a
+// plain function that the tests call when the emulated hardware fires it.
+
+#ifndef DCF77AVR_HOST_AVR_INTERRUPT_H_
+#define DCF77AVR_HOST_AVR_INTERRUPT_H_
+
+#define ISR(vector) void vector(void); void vector(void)
+
+#endif
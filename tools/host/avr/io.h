@@ -0,0 +1,45 @@
+// Stand-in for the AVR I/O registers, for the host tests: the registers
+// that the firmware uses are plain variables (see host.c), which the tests
+// set and inspect to emulate the hardware.
+
+#ifndef DCF77AVR_HOST_AVR_IO_H_
+#define DCF77AVR_HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+#define HOST_REGISTERS(reg8, reg16) \
+	reg8(DDRB) reg8(PORTB) reg8(PINB) \
+	reg8(DDRC) reg8(PORTC) reg8(PINC) \
+	reg8(DDRD) reg8(PORTD) reg8(PIND) \
+	reg8(EICRA) reg8(EIMSK) \
+	reg8(TCCR1A) reg8(TCCR1B) reg8(TCCR1C) reg8(TIMSK1) reg8(TIFR1) \
+	reg16(TCNT1) reg16(OCR1A) reg16(OCR1B) reg16(ICR1) \
+	reg8(ADMUX) reg8(ADCSRA) reg8(ADCSRB) reg16(ADC) reg8(DIDR0) \
+	reg8(ACSR) reg8(GPIOR0) \
+	reg16(UBRR0) reg8(UCSR0A) reg8(UCSR0B) reg8(UCSR0C) reg8(UDR0)
+
+#define HOST_REGISTER_8(name) extern volatile uint8_t name;
+#define HOST_REGISTER_16(name) extern volatile uint16_t name;
+HOST_REGISTERS(HOST_REGISTER_8, HOST_REGISTER_16)
+#undef HOST_REGISTER_8
+#undef HOST_REGISTER_16
+
+enum {
+	PB0 = 0, PB1 = 1, PB2 = 2, PB3 = 3, PB4 = 4, PB5 = 5,
+	PC0 = 0, PC5 = 5,
+	PD2 = 2, PD3 = 3, PD4 = 4,
+	ISC00 = 0, ISC01 = 1, INT0 = 0,
+	WGM10 = 0, WGM11 = 1, COM1B0 = 4, COM1B1 = 5, COM1A0 = 6, COM1A1 = 7,
+	CS10 = 0, CS11 = 1, CS12 = 2, WGM12 = 3, WGM13 = 4, ICES1 = 6,
+	ICNC1 = 7,
+	FOC1B = 6, FOC1A = 7,
+	TOIE1 = 0, OCIE1A = 1, OCIE1B = 2, ICIE1 = 5,
+	TOV1 = 0, OCF1A = 1, OCF1B = 2, ICF1 = 5,
+	MUX0 = 0, MUX1 = 1, MUX2 = 2, MUX3 = 3, REFS0 = 6, REFS1 = 7,
+	ADPS0 = 0, ADPS1 = 1, ADPS2 = 2, ADIE = 3, ADIF = 4, ADATE = 5,
+	ADSC = 6, ADEN = 7,
+	ACIC = 2,
+	TXEN0 = 3, RXEN0 = 4, UDRIE0 = 5, UDRE0 = 5,
+};
+
+#endif
@@ -0,0 +1,21 @@
+// Stand-in for the AVR flash access, for the host tests: flash is ordinary
+// memory.
+
+#ifndef DCF77AVR_HOST_AVR_PGMSPACE_H_
+#define DCF77AVR_HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(str) (str)
+
+#define pgm_read_byte(address) (*(const uint8_t *) (address))
+#define pgm_read_word(address) (*(const uint16_t *) (address))
+#define pgm_read_dword(address) (*(const uint32_t *) (address))
+
+#define memcpy_P memcpy
+#define printf_P printf
+#define fputs_P fputs
+
+#endif
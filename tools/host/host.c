@@ -0,0 +1,13 @@
+// The state behind the stand-ins for the AVR headers, and what the modules
+// under test need from those that aren't linked into the host tests.
+
+#include <stdint.h>
+
+#include <avr/io.h>
+
+#define HOST_REGISTER_8(name) volatile uint8_t name;
+#define HOST_REGISTER_16(name) volatile uint16_t name;
+HOST_REGISTERS(HOST_REGISTER_8, HOST_REGISTER_16)
+
+// From lcd.c.
+uint8_t lcd_redraw;
@@ -0,0 +1,15 @@
+// Stand-in for the AVR atomic blocks, for the host tests: the tests only
+// run an ISR between two statements of the main loop, never inside one.
+
+#ifndef DCF77AVR_HOST_UTIL_ATOMIC_H_
+#define DCF77AVR_HOST_UTIL_ATOMIC_H_
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON 1
+#define NONATOMIC_RESTORESTATE 0
+
+#define ATOMIC_BLOCK(type) \
+	for (int host_atomic_once = 1; host_atomic_once; host_atomic_once = 0)
+#define NONATOMIC_BLOCK(type) ATOMIC_BLOCK(type)
+
+#endif
@@ -0,0 +1,351 @@
+#!/usr/bin/env python3
+"""
+Determines the worst-case number of CPU cycles of each interrupt service
+routine, from the disassembly of the firmware.
+
+Each ISR is followed along its longest path, including the functions it
+calls, with the instruction timings of the ATmega328P; the interrupt
+response and the jump in the vector table are included. Loops are only
+bounded if they count a register down from a constant (ldi, ..., dec,
+brne), as the division routines of libgcc do; for any other loop, or an
+indirect call, the result is a lower bound, marked with '>='.
+
+With --rate, the cycles per second that an ISR takes up at the given
+number of interrupts per second are shown, too, and their total.
+
+Usage: avr-objdump -d dcf77avr.elf | isrcycles.py [--f-cpu HZ]
+                                                  [--rate NAME=PER_SECOND]...
+"""
+
+import re
+import sys
+
+# The interrupt vectors of the ATmega328P, by number.
+VECTORS = [
+    None, 'INT0', 'INT1', 'PCINT0', 'PCINT1', 'PCINT2', 'WDT',
+    'TIMER2_COMPA', 'TIMER2_COMPB', 'TIMER2_OVF', 'TIMER1_CAPT',
+    'TIMER1_COMPA', 'TIMER1_COMPB', 'TIMER1_OVF', 'TIMER0_COMPA',
+    'TIMER0_COMPB', 'TIMER0_OVF', 'SPI_STC', 'USART_RX', 'USART_UDRE',
+    'USART_TX', 'ADC', 'EE_READY', 'ANALOG_COMP', 'TWI', 'SPM_READY',
+]
+
+# Pushing the program counter, and the jmp in the vector table.
+INTERRUPT_ENTRY = 4 + 3
+
+# Instructions that don't take a single cycle; conditional branches and
+# skips are handled separately.
+CYCLES = {
+    'adiw': 2, 'sbiw': 2, 'mul': 2, 'muls': 2, 'mulsu': 2, 'fmul': 2,
+    'fmuls': 2, 'fmulsu': 2, 'ld': 2, 'ldd': 2, 'lds': 2, 'st': 2,
+    'std': 2, 'sts': 2, 'push': 2, 'pop': 2, 'cbi': 2, 'sbi': 2,
+    'rjmp': 2, 'ijmp': 2, 'jmp': 3, 'rcall': 3, 'icall': 3, 'call': 4,
+    'lpm': 3, 'elpm': 3, 'ret': 4, 'reti': 4,
+}
+
+SKIPS = ('cpse', 'sbrc', 'sbrs', 'sbic', 'sbis')
+
+LABEL = re.compile(r'^([0-9a-f]+) <([^>]+)>:$')
+INSTRUCTION = re.compile(
+    r'^\s*([0-9a-f]+):\s+((?:[0-9a-f]{2} )+)\s*([a-z]+)\s*([^;]*)(?:;(.*))?$')
+RELATIVE = re.compile(r'\.([+-]\d+)')
+ADDRESS = re.compile(r'0x([0-9a-f]+)')
+
+
+class Instruction:
+    def __init__(self, address, size, mnemonic, operands, comment):
+        self.address = address
+        # In words.
+        self.size = size
+        self.mnemonic = mnemonic
+        self.operands = operands.strip()
+        self.comment = comment or ''
+
+    def target(self):
+        """
+        Returns the address that a jump, branch or call goes to.
+        """
+        match = ADDRESS.search(self.comment)
+        if match:
+            return int(match.group(1), 16)
+        match = RELATIVE.search(self.operands)
+        if match:
+            return self.address + 2 + int(match.group(1))
+        match = ADDRESS.search(self.operands)
+        if match:
+            return int(match.group(1), 16)
+        return None
+
+
+def parse(listing):
+    """
+    Returns the instructions by address, and the addresses of the symbols.
+    """
+    instructions = {}
+    symbols = {}
+    for line in listing:
+        line = line.rstrip('\n')
+        match = LABEL.match(line)
+        if match:
+            symbols[match.group(2)] = int(match.group(1), 16)
+            continue
+        match = INSTRUCTION.match(line)
+        if match:
+            address = int(match.group(1), 16)
+            size = len(match.group(2).split()) // 2
+            instructions[address] = Instruction(
+                address, size, match.group(3), match.group(4),
+                match.group(5))
+    return instructions, symbols
+
+
+class Analysis:
+    """
+    Finds the longest path from an address to the return of its function.
+    """
+
+    def __init__(self, instructions, names):
+        self.instructions = instructions
+        self.names = names
+        # Results by address: (cycles, notes).
+        self.functions = {}
+        self.in_progress = set()
+
+    def name(self, address):
+        return self.names.get(address, '0x%x' % address)
+
+    def successors(self, instruction, notes):
+        """
+        Yields the addresses that may follow the instruction, with the
+        cycles it takes to get there.
+        """
+        mnemonic = instruction.mnemonic
+        following = instruction.address + 2 * instruction.size
+
+        if mnemonic in ('ret', 'reti'):
+            return
+        if mnemonic in ('ijmp', 'eijmp'):
+            notes.add('indirect jump at 0x%x' % instruction.address)
+            return
+        if mnemonic in ('jmp', 'rjmp'):
+            yield instruction.target(), CYCLES[mnemonic]
+            return
+        if mnemonic in ('call', 'rcall'):
+            cycles, callee_notes = self.function(instruction.target())
+            notes.update(callee_notes)
+            yield following, CYCLES[mnemonic] + cycles
+            return
+        if mnemonic in ('icall', 'eicall'):
+            notes.add('indirect call at 0x%x' % instruction.address)
+            yield following, CYCLES['icall']
+            return
+        if mnemonic.startswith('br') and mnemonic != 'break':
+            yield following, 1
+            yield instruction.target(), 2
+            return
+        if mnemonic in SKIPS:
+            skipped = self.instructions.get(following)
+            yield following, 1
+            if skipped is not None:
+                yield (following + 2 * skipped.size,
+                       2 if skipped.size == 1 else 3)
+            return
+        yield following, CYCLES.get(mnemonic, 1)
+
+    def function(self, entry):
+        """
+        Returns the worst-case cycles from entry up to and including the
+        return, and notes on why that may be a lower bound.
+        """
+        if entry in self.functions:
+            return self.functions[entry]
+        if entry in self.in_progress:
+            return 0, {'recursion into %s' % self.name(entry)}
+        self.in_progress.add(entry)
+
+        notes = set()
+        edges = {}
+        back_edges = set()
+
+        # Depth-first search, to find the edges and the back edges.
+        state = {}
+        stack = [(entry, None)]
+        while stack:
+            address, pending = stack[-1]
+            if pending is None:
+                state[address] = 'open'
+                instruction = self.instructions.get(address)
+                if instruction is None:
+                    notes.add('unknown code at 0x%x' % address)
+                    edges[address] = []
+                else:
+                    edges[address] = list(
+                        self.successors(instruction, notes))
+                pending = iter(edges[address])
+                stack[-1] = (address, pending)
+
+            for successor, _ in pending:
+                if successor is None:
+                    notes.add('unknown target after 0x%x' % address)
+                elif state.get(successor) == 'open':
+                    back_edges.add((address, successor))
+                elif successor not in state:
+                    stack.append((successor, None))
+                    break
+            else:
+                state[address] = 'done'
+                stack.pop()
+
+        # The loops, by header: the tails of their back edges, and the
+        # addresses that can reach those without passing the header.
+        predecessors = {}
+        for address, successors in edges.items():
+            for successor, _ in successors:
+                predecessors.setdefault(successor, []).append(address)
+        loops = {}
+        for tail, header in back_edges:
+            loops.setdefault(header, (set(), {header}))[0].add(tail)
+        for header, (tails, body) in loops.items():
+            pending = list(tails)
+            while pending:
+                address = pending.pop()
+                if address not in body:
+                    body.add(address)
+                    pending.extend(predecessors.get(address, []))
+
+        extra = {}
+        # Inner loops first, so the passes of outer loops include them.
+        for header, (tails, body) in sorted(loops.items(),
+                                            key=lambda l: len(l[1][1])):
+            iterations = self.loop_bound(body)
+            if iterations is None:
+                notes.add('unbounded loop at 0x%x' % header)
+                continue
+            # Each pass but the last goes back to the header.
+            one_pass = max(
+                self.longest(edges, back_edges, extra, header, tail,
+                             header) +
+                max(cycles for successor, cycles in edges[tail]
+                    if successor == header)
+                for tail in tails)
+            extra[header] = (iterations - 1) * one_pass
+
+        cycles = self.longest(edges, back_edges, extra, entry, None, None)
+        self.in_progress.discard(entry)
+        self.functions[entry] = (max(cycles, 0), notes)
+        return self.functions[entry]
+
+    def longest(self, edges, back_edges, extra, start, target, header):
+        """
+        Returns the cycles of the longest path from start to target (or to
+        a return, if target is None), without taking back edges; the extra
+        cycles of the loops passed on the way are added, except for those
+        of header.
+        """
+        memo = {}
+        unreachable = float('-inf')
+
+        def visit(address):
+            if address in memo:
+                return memo[address]
+            instruction = self.instructions.get(address)
+            if address == target:
+                result = 0
+            elif instruction is None:
+                result = unreachable
+            elif instruction.mnemonic in ('ret', 'reti'):
+                result = CYCLES['ret'] if target is None else unreachable
+            else:
+                result = unreachable
+                for successor, cycles in edges.get(address, []):
+                    if successor is None or (address, successor) in \
+                            back_edges:
+                        continue
+                    result = max(result, cycles + visit(successor))
+            if address != header:
+                result += extra.get(address, 0)
+            memo[address] = result
+            return result
+
+        return visit(start)
+
+    def loop_bound(self, body):
+        """
+        Returns how often the loop with the given addresses runs, if it
+        counts a register down to zero (dec, brne) from a constant loaded
+        before it (ldi).
+        """
+        register = None
+        for address in sorted(body):
+            instruction = self.instructions[address]
+            previous = self.instructions.get(address - 2)
+            if instruction.mnemonic == 'brne' and address - 2 in body and \
+                    previous.mnemonic == 'dec':
+                register = previous.operands
+                break
+        if register is None:
+            return None
+
+        # The nearest write to the register before the loop.
+        start = min(body)
+        for address in range(start - 2, max(start - 256, 0) - 2, -2):
+            instruction = self.instructions.get(address)
+            if instruction is None:
+                continue
+            operands = [o.strip() for o in instruction.operands.split(',')]
+            if operands[0] != register:
+                continue
+            if instruction.mnemonic != 'ldi':
+                return None
+            value = int(operands[1], 0)
+            return value if value > 0 else 256
+        return None
+
+
+def main():
+    args = sys.argv[1:]
+    f_cpu = 16000000
+    rates = {}
+    while args:
+        if args[0] == '--f-cpu' and len(args) > 1:
+            f_cpu = int(args[1])
+        elif args[0] == '--rate' and len(args) > 1 and '=' in args[1]:
+            name, rate = args[1].split('=', 1)
+            rates[name] = float(rate)
+        else:
+            sys.stderr.write(__doc__.lstrip())
+            sys.exit(1)
+        args = args[2:]
+
+    instructions, symbols = parse(sys.stdin)
+    names = {address: name for name, address in symbols.items()}
+    analysis = Analysis(instructions, names)
+
+    total_load = 0
+    total_bound = ''
+    for number, vector in enumerate(VECTORS):
+        address = symbols.get('__vector_%d' % number)
+        if address is None:
+            continue
+
+        cycles, notes = analysis.function(address)
+        cycles += INTERRUPT_ENTRY
+        bound = '>=' if notes else ''
+        line = '%-12s %s%d cycles (%.1f us)' % (
+            vector, bound, cycles, cycles * 1e6 / f_cpu)
+        if vector in rates:
+            load = cycles * rates[vector]
+            line += ', %s%.0f cycles/s (%.3f%%) at %g/s' % (
+                bound, load, load * 100 / f_cpu, rates[vector])
+            total_load += load
+            total_bound = total_bound or bound
+        print(line)
+        for note in sorted(notes):
+            print('    ' + note)
+
+    if rates:
+        print('Total load at the given rates: %s%.0f cycles/s (%.3f%%)' % (
+            total_bound, total_load, total_load * 100 / f_cpu))
+
+
+if __name__ == '__main__':
+    main()
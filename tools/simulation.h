@@ -0,0 +1,411 @@
+// Emulation of the hardware around the firmware, for the host tests:
+// Timer 1 (periodic or tickless, with a resonator that is off by
+// simulation_ppm, and the PPS output on OC1B) and a DCF77 receiver on INT0.
+// The ISRs are invoked as the emulated time passes; after each edge of the
+// signal, the polling of the main loop is done.
+
+#ifndef DCF77AVR_TOOLS_SIMULATION_H_
+#define DCF77AVR_TOOLS_SIMULATION_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <avr/io.h>
+
+#include "dcf_processor.h"
+#include "dcf_receiver.h"
+#include "gregorian_calendar.h"
+#include "monotime.h"
+#include "oscillator.h"
+#include "phase_tracker.h"
+#include "pps.h"
+#include "time_estimator.h"
+
+void INT0_vect(void);
+void TIMER1_COMPA_vect(void);
+#if !defined(MONOTIME_TICKLESS) || defined(PPS_OUTPUT)
+void TIMER1_COMPB_vect(void);
+#endif
+#ifdef MONOTIME_TICKLESS
+void TIMER1_OVF_vect(void);
+#endif
+
+// The unit of the emulated time: the count of the periodic timer at an
+// exact 16 MHz.
+#define SIMULATION_HZ 2000000ULL
+
+// The start of the first DCF77 minute; the second starts of the signal
+// are on this grid.
+#define SIMULATION_START (5 * SIMULATION_HZ + 12345)
+
+// The frequency error of the resonator, in ppm.
+static double simulation_ppm = 0;
+// The edges of the signal are off by up to this many us (uniformly
+// distributed).
+static int32_t simulation_jitter = 0;
+// Whether the oscillator is disciplined by the decoded frames.
+static uint8_t simulation_discipline = 1;
+
+// The emulated time, in SIMULATION_HZ.
+static uint64_t simulation_time = 0;
+
+// The decoded and rejected frames.
+static long simulation_frames_ok = 0;
+static long simulation_frames_bad = 0;
+
+/**
+ * The deviations of events from the second starts of the signal.
+ */
+struct simulation_errors {
+	long count;
+	double sum;
+	double squares;
+	double max;
+};
+
+// If set, the deviations of the calendar's second ticks, and of the rising
+// edges of the pulses on OC1B, are recorded there.
+static struct simulation_errors *simulation_ticks = NULL;
+static struct simulation_errors *simulation_pulses = NULL;
+
+// The seconds that the calendar has been advanced by the ISRs, and those of
+// them that started a second of the signal that had been started already.
+static long simulation_tick_count = 0;
+static long simulation_double_ticks = 0;
+
+// The pulses on OC1B: their count, those that started a second of the
+// signal that had been started already, and their widths (in us).
+static long simulation_pulse_count = 0;
+static long simulation_double_pulses = 0;
+static double simulation_width_min = INFINITY;
+static double simulation_width_max = 0;
+
+// The interrupts of Timer 1 so far.
+static long simulation_overflows = 0;
+static long simulation_compares = 0;
+
+/**
+ * Returns the second of the signal that the given time is closest to (as
+ * counted from SIMULATION_START), and stores the deviation from its start
+ * in us.
+ */
+static long simulation_second(double time, double *deviation) {
+	double second = floor((time - SIMULATION_START) / SIMULATION_HZ + 0.5);
+	*deviation = (time - SIMULATION_START - second * SIMULATION_HZ) *
+	             1e6 / SIMULATION_HZ;
+	return (long) second;
+}
+
+static void simulation_record(struct simulation_errors *errors,
+	double deviation) {
+
+	if (!errors) {
+		return;
+	}
+
+	errors->count++;
+	errors->sum += deviation;
+	errors->squares += deviation * deviation;
+	if (fabs(deviation) > errors->max) {
+		errors->max = fabs(deviation);
+	}
+}
+
+static double simulation_mean(struct simulation_errors *errors) {
+	return errors->count ? errors->sum / errors->count : 0;
+}
+
+static double simulation_rms(struct simulation_errors *errors) {
+	return errors->count ? sqrt(errors->squares / errors->count) : 0;
+}
+
+/**
+ * Records a second tick if the calendar has been advanced since
+ * unix_time_before was taken, at the given raw time (in counts of the
+ * resonator's clock, divided by 8).
+ */
+static void simulation_check_tick(uint32_t unix_time_before, double raw) {
+	static long last_second = -1000000;
+
+	if (current_date_time.unix_time == unix_time_before) {
+		return;
+	}
+
+	double deviation;
+	long second = simulation_second(raw / (1 + simulation_ppm * 1e-6),
+	                                &deviation);
+	simulation_tick_count++;
+	if (second == last_second) {
+		simulation_double_ticks++;
+	}
+	last_second = second;
+	simulation_record(simulation_ticks, deviation);
+}
+
+/**
+ * Applies a compare match on OC1B to the pin, as the compare output mode
+ * says, at the given raw time.
+ */
+static void simulation_match_b(double raw) {
+	static double rise;
+	static long last_second = -1000000;
+
+	double time = raw / (1 + simulation_ppm * 1e-6);
+	uint8_t mode = (TCCR1A >> COM1B0) & 3;
+
+	if (mode == 3 && !(PINB & (1 << PB2))) {
+		PINB |= (1 << PB2);
+		rise = time;
+
+		double deviation;
+		long second = simulation_second(time, &deviation);
+		simulation_pulse_count++;
+		if (second == last_second) {
+			simulation_double_pulses++;
+		}
+		last_second = second;
+		simulation_record(simulation_pulses, deviation);
+	} else if (mode == 2 && (PINB & (1 << PB2))) {
+		PINB &= ~(1 << PB2);
+
+		double width = (time - rise) * 1e6 / SIMULATION_HZ;
+		if (width < simulation_width_min) {
+			simulation_width_min = width;
+		}
+		if (width > simulation_width_max) {
+			simulation_width_max = width;
+		}
+	}
+}
+
+#ifdef MONOTIME_TICKLESS
+
+// The counter, without wrapping.
+static uint64_t simulation_counter = 0;
+
+/**
+ * Lets the emulated time pass up to the given time; Timer 1 counts every
+ * 1024 cycles of the resonator.
+ */
+static void simulation_advance(uint64_t time) {
+	uint64_t end = (uint64_t) (time * (1 + simulation_ppm * 1e-6)) / 128;
+
+	for (;;) {
+		uint64_t counter = simulation_counter;
+		uint64_t overflow = (counter / 65536 + 1) * 65536;
+		uint64_t match_a = counter +
+			(uint16_t) (OCR1A - (uint16_t) counter - 1) + 1;
+		uint64_t match_b = counter +
+			(uint16_t) (OCR1B - (uint16_t) counter - 1) + 1;
+		uint64_t next = overflow < match_a ? overflow : match_a;
+		next = match_b < next ? match_b : next;
+		if (next > end) {
+			break;
+		}
+
+		simulation_counter = next;
+		TCNT1 = (uint16_t) next;
+
+		uint8_t interrupt_b = 0;
+		if (next == match_b) {
+			simulation_match_b((double) next * 128);
+			interrupt_b = TIMSK1 & (1 << OCIE1B);
+		}
+		if (next == match_a) {
+			uint32_t unix_time = current_date_time.unix_time;
+			simulation_compares++;
+			if (next == overflow) {
+				TIFR1 |= (1 << TOV1);
+			}
+			TIMER1_COMPA_vect();
+			TIFR1 &= ~(1 << TOV1);
+			simulation_check_tick(unix_time, (double) next * 128);
+		}
+		if (next == overflow) {
+			simulation_overflows++;
+			TIMER1_OVF_vect();
+		}
+#ifdef PPS_OUTPUT
+		if (interrupt_b) {
+			TIMER1_COMPB_vect();
+		}
+#else
+		(void) interrupt_b;
+#endif
+	}
+
+	simulation_counter = end;
+	TCNT1 = (uint16_t) end;
+	simulation_time = time;
+}
+
+#else
+
+// The raw time of the last compare match A, i.e. the start of the current
+// timer period, and the raw time up to which the timer has run.
+static uint64_t simulation_period_start = 0;
+static uint64_t simulation_raw = 0;
+
+/**
+ * Lets the emulated time pass up to the given time; Timer 1 counts every
+ * 8 cycles of the resonator, and restarts at compare match A.
+ */
+static void simulation_advance(uint64_t time) {
+	uint64_t end = (uint64_t) (time * (1 + simulation_ppm * 1e-6));
+
+	for (;;) {
+		uint64_t match_a = simulation_period_start + OCR1A + 1;
+		uint64_t match_b = OCR1B <= OCR1A &&
+			simulation_period_start + OCR1B > simulation_raw ?
+			simulation_period_start + OCR1B : UINT64_MAX;
+		uint64_t next = match_a < match_b ? match_a : match_b;
+		if (next > end) {
+			break;
+		}
+
+		uint32_t unix_time = current_date_time.unix_time;
+		simulation_raw = next;
+		if (next == match_b) {
+			simulation_match_b((double) next);
+			if (TIMSK1 & (1 << OCIE1B)) {
+				TCNT1 = OCR1B;
+				TIMER1_COMPB_vect();
+			}
+		} else {
+			simulation_period_start = match_a;
+			TCNT1 = 0;
+			simulation_compares++;
+			TIMER1_COMPA_vect();
+
+			// A compare value of 0 matches right away.
+			if (OCR1B == 0) {
+				simulation_match_b((double) next);
+				if (TIMSK1 & (1 << OCIE1B)) {
+					TIMER1_COMPB_vect();
+				}
+			}
+		}
+		simulation_check_tick(unix_time, (double) next);
+	}
+
+	simulation_raw = end;
+	TCNT1 = end - simulation_period_start;
+	simulation_time = time;
+}
+
+#endif
+
+/**
+ * Does what the main loop does with the receiver's results.
+ */
+static void simulation_poll() {
+	struct dcf_frame frame;
+
+	while (dcf_poll_frame(&frame)) {
+		if (dcf_process(&frame)) {
+			simulation_frames_ok++;
+			if (simulation_discipline) {
+				oscillator_feed(frame.timestamp_monotime,
+					frame.timestamp_ticks);
+			}
+			time_estimator_feed(frame.timestamp_monotime,
+				frame.timestamp_ticks);
+		} else {
+			simulation_frames_bad++;
+		}
+	}
+
+	if (dcf_poll_partial(&frame)) {
+		dcf_process_partial(&frame);
+	}
+
+	uint32_t second_monotime, second_ticks;
+	if (dcf_poll_second(&second_monotime, &second_ticks)) {
+		phase_tracker_feed(second_monotime);
+#ifdef PPS_MEASURE
+		pps_feed_second(second_ticks);
+#endif
+	}
+
+#ifdef PPS_OUTPUT
+	pps_update();
+#endif
+}
+
+/**
+ * Lets the emulated time pass up to the given time, polling at the given
+ * interval (in SIMULATION_HZ), as the main loop would.
+ */
+static void simulation_idle(uint64_t time, uint64_t interval) {
+	while (simulation_time + interval < time) {
+		simulation_advance(simulation_time + interval);
+		simulation_poll();
+	}
+	simulation_advance(time);
+	simulation_poll();
+}
+
+/**
+ * Emits an edge of the signal (1 for rising) at the given time, plus the
+ * jitter.
+ */
+static void simulation_edge(uint64_t time, uint8_t level) {
+	if (simulation_jitter) {
+		int32_t jitter = rand() % (2 * simulation_jitter + 1) -
+		                 simulation_jitter;
+		time += (int64_t) jitter * (int64_t) (SIMULATION_HZ / 1000000);
+	}
+
+	simulation_advance(time);
+	PIND = level ? (1 << PD2) : 0;
+	INT0_vect();
+	simulation_poll();
+}
+
+/**
+ * Emits a pulse of the given length in ms that starts at the given time.
+ */
+static void simulation_pulse(uint64_t rise, uint16_t length) {
+	simulation_edge(rise, 1);
+	simulation_edge(rise + length * SIMULATION_HZ / 1000, 0);
+}
+
+/**
+ * Emits the pulses of a minute.
+ *
+ * @param start:
+ *     The start of the minute.
+ * @param bits:
+ *     The bits of the minute (see test_encode_minute).
+ * @param pulse_ms:
+ *     If not NULL, returns the length in ms of the pulse in the given
+ *     second, for the given bit (0 for no pulse).
+ * @returns
+ *     The start of the next minute.
+ */
+static uint64_t simulation_minute(uint64_t start, const uint8_t bits[60],
+	uint16_t (*pulse_ms)(uint8_t second, uint8_t bit)) {
+
+	for (uint8_t second = 0; second < 59; second++) {
+		uint16_t length = pulse_ms ? pulse_ms(second, bits[second]) :
+		                  bits[second] ? 200 : 100;
+		if (length) {
+			simulation_pulse(start + second * SIMULATION_HZ,
+			                 length);
+		}
+	}
+
+	return start + 60 * SIMULATION_HZ;
+}
+
+/**
+ * Initializes the modules as main() does.
+ */
+static void simulation_init() {
+	dcf_receiver_init();
+	monotime_init();
+	gregorian_calendar_init();
+}
+
+#endif
@@ -0,0 +1,125 @@
+// Helpers for the host tests (run by 'make test'): checks that count their
+// failures, test cases that each start from a freshly loaded program, and
+// the encoding of DCF77 minutes.
+
+#ifndef DCF77AVR_TOOLS_TEST_H_
+#define DCF77AVR_TOOLS_TEST_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+// The number of failed checks; only the first few are reported.
+static unsigned long test_failures = 0;
+#define TEST_REPORTED_FAILURES 10
+
+/**
+ * Checks the given condition; if it doesn't hold, the failure is counted,
+ * and reported with the given printf arguments.
+ */
+#define CHECK(condition, ...) do { \
+	if (!(condition)) { \
+		if (test_failures++ < TEST_REPORTED_FAILURES) { \
+			printf("%s:%d: check failed: ", __FILE__, __LINE__); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+		} \
+	} \
+} while (0)
+
+/**
+ * Runs a test case in a child process, so that it starts from the initial
+ * state of all modules, and counts it as a single failure if any of its
+ * checks has failed.
+ *
+ * @param name:
+ *     The name of the test case, for the report.
+ * @param run:
+ *     The test case; it may read the parameters that the caller has set
+ *     in global variables.
+ */
+static void test_case(const char *name, void (*run)()) {
+	fflush(stdout);
+
+	pid_t child = fork();
+	if (child == 0) {
+		test_failures = 0;
+		run();
+		fflush(stdout);
+		_exit(test_failures ? 1 : 0);
+	}
+
+	int status;
+	if (child < 0 || waitpid(child, &status, 0) != child ||
+	    !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		test_failures++;
+		printf("%s: FAILED\n", name);
+	} else {
+		printf("%s: ok\n", name);
+	}
+}
+
+/**
+ * Reports the result of the test program.
+ *
+ * @returns
+ *     The exit status of the test program.
+ */
+static int test_report(const char *program) {
+	if (test_failures) {
+		printf("%s: %lu failed\n", program, test_failures);
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Encodes the given local time as the bits of a DCF77 minute; the weather
+ * bits (1 to 14) and all announcements are 0.
+ *
+ * @param bits:
+ *     The bits are stored here, indexed by the second in which they are
+ *     sent (bit 59, which doesn't exist, is 0).
+ * @param cest:
+ *     1 for CEST, 0 for CET.
+ */
+static void test_encode_minute(uint8_t bits[60], uint8_t minute,
+	uint8_t hour, uint8_t day_of_month, uint8_t day_of_week, uint8_t month,
+	uint8_t year, uint8_t cest) {
+
+	// Each field as its second, width and value; the parity bits follow
+	// the last field of their group.
+	const uint8_t fields[][3] = {
+		{21, 7, minute}, {29, 6, hour}, {36, 6, day_of_month},
+		{42, 3, day_of_week}, {45, 5, month}, {50, 8, year},
+	};
+
+	memset(bits, 0, 60);
+	bits[17] = cest;
+	bits[18] = !cest;
+	bits[20] = 1;
+
+	uint8_t parity = 0;
+	for (uint8_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+		uint8_t value = fields[i][2];
+		uint8_t bcd = ((value / 10) << 4) | (value % 10);
+		for (uint8_t bit = 0; bit < fields[i][1]; bit++) {
+			bits[fields[i][0] + bit] = (bcd >> bit) & 1;
+			parity ^= (bcd >> bit) & 1;
+		}
+
+		// The minute, the hour and the date are each protected by a
+		// parity bit.
+		if (i <= 1 || i == 5) {
+			uint8_t end = fields[i][0] + fields[i][1];
+			bits[end] = parity;
+			parity = 0;
+		}
+	}
+}
+
+#endif
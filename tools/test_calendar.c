@@ -0,0 +1,149 @@
+// Host test of the conversions between civil dates, UNIX dates and UNIX
+// times (see gregorian_calendar.h), against the C library.
+
+#include <stdint.h>
+#include <time.h>
+
+#include "gregorian_calendar.h"
+#include "test.h"
+
+// 2000-01-01 and 2800-01-01.
+#define FIRST_DATE 10957L
+#define END_DATE (FIRST_DATE + 2 * 146097L)
+
+/**
+ * Converts the given UNIX date with gmtime_r.
+ */
+static struct tm reference_date(long unix_date) {
+	time_t time = (time_t) unix_date * 86400;
+	struct tm tm;
+	gmtime_r(&time, &tm);
+	return tm;
+}
+
+/**
+ * Every day from 2000 to 2799 is converted to a date and back.
+ */
+static void test_unix_date() {
+	for (long day = FIRST_DATE; day < END_DATE; day++) {
+		struct tm tm = reference_date(day);
+		int year = tm.tm_year + 1900;
+
+		struct gregorian_date date;
+		gregorian_date_from_unix_date(&date, day);
+		CHECK(date.century == year / 100 && date.year == year % 100 &&
+		      date.month == tm.tm_mon + 1 &&
+		      date.day_of_month == tm.tm_mday &&
+		      date.day_of_week == tm.tm_wday,
+		      "UNIX date %ld is %d%02d-%02d-%02d (%d), "
+		      "not %d-%02d-%02d (%d)", day, date.century, date.year,
+		      date.month, date.day_of_month, date.day_of_week, year,
+		      tm.tm_mon + 1, tm.tm_mday, tm.tm_wday);
+
+		gregorian_date_calculate_unix_date(&date);
+		CHECK(date.unix_date == (uint32_t) day,
+		      "%d-%02d-%02d is UNIX date %u, not %ld", year,
+		      tm.tm_mon + 1, tm.tm_mday, date.unix_date, day);
+		CHECK(gregorian_date_is_leap_year(&date) ==
+		      (year % 4 == 0 && (year % 100 != 0 || year % 400 == 0)),
+		      "%d is a leap year: %d", year,
+		      gregorian_date_is_leap_year(&date));
+	}
+}
+
+/**
+ * The century of each date from 2015 to 2414, as transmitted (with a two
+ * digit year, and sunday == 7), is selected by its day of week; any other
+ * day of week selects a century in which the date has it, or none.
+ */
+static void test_century() {
+	// 2015-01-01 and 2415-01-01.
+	for (long day = 16436; day < 16436 + 146097; day++) {
+		struct tm tm = reference_date(day);
+		int year = tm.tm_year + 1900;
+
+		for (uint8_t day_of_week = 1; day_of_week <= 7; day_of_week++) {
+			struct gregorian_date date = {0};
+			date.year = year % 100;
+			date.month = tm.tm_mon + 1;
+			date.day_of_month = tm.tm_mday;
+			date.day_of_week = day_of_week;
+
+			uint8_t valid = gregorian_date_validate(&date);
+			if (day_of_week % 7 == tm.tm_wday) {
+				CHECK(valid && date.unix_date == (uint32_t) day,
+				      "%d-%02d-%02d selected century %d "
+				      "(valid: %d)", year, tm.tm_mon + 1,
+				      tm.tm_mday, date.century, valid);
+			} else if (valid) {
+				struct gregorian_date selected;
+				gregorian_date_from_unix_date(&selected,
+				                              date.unix_date);
+				CHECK(selected.year == year % 100 &&
+				      selected.month == tm.tm_mon + 1 &&
+				      selected.day_of_month == tm.tm_mday &&
+				      selected.day_of_week == day_of_week % 7,
+				      "%d-%02d-%02d on day %d selected "
+				      "UNIX date %u", year, tm.tm_mon + 1,
+				      tm.tm_mday, day_of_week, date.unix_date);
+			}
+		}
+
+		// The day after the last of the month.
+		struct tm next = reference_date(day + 1);
+		if (next.tm_mday == 1) {
+			struct gregorian_date date = {0};
+			date.year = year % 100;
+			date.month = tm.tm_mon + 1;
+			date.day_of_month = tm.tm_mday + 1;
+			date.day_of_week = next.tm_wday ? next.tm_wday : 7;
+			CHECK(!gregorian_date_validate(&date),
+			      "%d-%02d-%02d valid", year, tm.tm_mon + 1,
+			      tm.tm_mday + 1);
+		}
+	}
+}
+
+/**
+ * UNIX times from 2000 to 9999, sampled at irregular intervals, are
+ * converted to the date and time in each timezone and back.
+ */
+static void test_unix_time() {
+	unsigned long step = 0;
+	for (uint64_t time = 946684800ULL; time < 253402300799ULL;
+	     time += 86400ULL * 37 + 3599 + step % 7919, step++) {
+
+		for (int8_t timezone = -2; timezone <= 2; timezone++) {
+			struct gregorian_date_time datetime = {0};
+			datetime.timezone = timezone;
+			gregorian_date_time_from_unix_time(&datetime,
+				(uint8_t) (time >> 32), (uint32_t) time);
+
+			uint64_t local = time + timezone * 3600;
+			uint32_t second = local % 86400;
+			CHECK(datetime.date.unix_date == local / 86400 &&
+			      datetime.time.hour == second / 3600 &&
+			      datetime.time.minute == second / 60 % 60 &&
+			      datetime.time.second == second % 60,
+			      "UNIX time %llu in timezone %d",
+			      (unsigned long long) time, timezone);
+
+			datetime.unix_time = 0;
+			datetime.unix_era = 0;
+			gregorian_date_time_calculate_unix_time(&datetime);
+			CHECK(datetime.unix_time == (uint32_t) time &&
+			      datetime.unix_era == (uint8_t) (time >> 32),
+			      "UNIX time %llu in timezone %d converted back to "
+			      "%d:%u", (unsigned long long) time, timezone,
+			      datetime.unix_era, datetime.unix_time);
+		}
+	}
+}
+
+int main() {
+	test_case("calendar: UNIX date", test_unix_date);
+	test_case("calendar: century", test_century);
+	test_case("calendar: UNIX time", test_unix_time);
+
+	return test_report("test_calendar");
+}
@@ -0,0 +1,94 @@
+// Host test of the adaptive pulse and gap windows (see dcf_classifier.h).
+
+#include <stdint.h>
+
+#include "dcf_classifier.h"
+#include "test.h"
+
+// The receiver stretches the pulses by this many ms.
+static uint32_t stretch;
+
+/**
+ * Feeds the classifier with the given number of minutes of alternating 0
+ * and 1 bits, stretched by the receiver, with the gaps up to the next
+ * second (the minute-end marker being the last one).
+ *
+ * @returns
+ *     The number of pulses and gaps that have been misclassified.
+ */
+static long receive_minutes(uint8_t minutes) {
+	long wrong = 0;
+
+	for (uint8_t minute = 0; minute < minutes; minute++) {
+		for (uint8_t second = 0; second < 59; second++) {
+			uint8_t bit = second & 1;
+			uint32_t pulse = DCF_TICKS(100 + 100 * bit + stretch,
+			                           1000);
+			// The gaps vary by up to 2 ms.
+			uint32_t gap = DCF_TICKS(1, 1) - pulse +
+			               DCF_TICKS(second % 3, 1000);
+			if (second == 58) {
+				gap += DCF_TICKS(1, 1);
+			}
+
+			uint8_t confidence;
+			wrong += dcf_classify_pulse(pulse, &confidence) != bit;
+			uint8_t gap_type = second == 58 ? DCF_GAP_MINUTE :
+			                   DCF_GAP_SECOND;
+			wrong += dcf_classify_gap(gap, pulse) != gap_type;
+		}
+
+		dcf_classifier_adapt();
+	}
+
+	return wrong;
+}
+
+/**
+ * Pulses that are stretched beyond the initial 1 window are classified
+ * once the windows have followed them.
+ */
+static void test_stretched_pulses() {
+	stretch = 40;
+	dcf_classifier_init();
+
+	uint8_t confidence;
+	CHECK(dcf_classify_pulse(DCF_TICKS(240, 1000), &confidence) ==
+	      DCF_PULSE_INVALID, "240 ms pulse valid before adapting");
+
+	receive_minutes(5);
+
+	CHECK(receive_minutes(1) == 0, "misclassified after adapting");
+	CHECK(dcf_classify_pulse(DCF_TICKS(240, 1000), &confidence) ==
+	      DCF_PULSE_1, "240 ms pulse not a 1 after adapting");
+	CHECK(confidence > DCF_CONFIDENCE_MAX * 3 / 4,
+	      "confidence %d at the adapted 1 length", confidence);
+	CHECK(dcf_classify_pulse(DCF_TICKS(140, 1000), &confidence) ==
+	      DCF_PULSE_0, "140 ms pulse not a 0 after adapting");
+	CHECK(confidence > DCF_CONFIDENCE_MAX * 3 / 4,
+	      "confidence %d at the adapted 0 length", confidence);
+}
+
+/**
+ * Gaps are measured together with the pulse before them, so the second and
+ * minute-end windows don't depend on whether that pulse was a 0 or a 1.
+ */
+static void test_gaps() {
+	stretch = 20;
+	dcf_classifier_init();
+
+	CHECK(receive_minutes(5) == 0, "misclassified pulses or gaps");
+
+	// A second start without a pulse before it.
+	CHECK(dcf_classify_gap(DCF_TICKS(1, 1), 0) == DCF_GAP_SECOND,
+	      "gap without pulse");
+	CHECK(dcf_classify_gap(DCF_TICKS(3, 2), DCF_TICKS(100, 1000)) ==
+	      DCF_GAP_INVALID, "1.5 s gap valid");
+}
+
+int main() {
+	test_case("classifier: stretched pulses", test_stretched_pulses);
+	test_case("classifier: gaps", test_gaps);
+
+	return test_report("test_classifier");
+}
@@ -0,0 +1,120 @@
+// Host test of the clock (see gregorian_calendar.h): the seconds counted by
+// gregorian_calendar_tick, as read through gregorian_calendar_now, against
+// stepping a date-time with gregorian_date_time_increment.
+
+#include <stdint.h>
+
+#include "gregorian_calendar.h"
+#include "test.h"
+
+// A little over two hours.
+#define SECONDS 7300
+
+/**
+ * Sets the clock to the given local time, ticks it for SECONDS, and checks
+ * it against the incremented date-time after each second.
+ *
+ * @param timezone:
+ *     1 for CET, 2 for CEST.
+ */
+static void run_clock(uint8_t century, uint8_t year, uint8_t month,
+	uint8_t day_of_month, uint8_t hour, uint8_t minute, int8_t timezone,
+	uint8_t timezone_change_announced, uint8_t leap_second_announced) {
+
+	struct gregorian_date_time expected = {0};
+	expected.date.century = century;
+	expected.date.year = year;
+	expected.date.month = month;
+	expected.date.day_of_month = day_of_month;
+	expected.time.hour = hour;
+	expected.time.minute = minute;
+	expected.timezone = timezone;
+	expected.timezone_change_announced = timezone_change_announced;
+	expected.time.leap_second_announced = leap_second_announced;
+
+	gregorian_date_calculate_unix_date(&expected.date);
+	// 1970-01-01 was a thursday
+	expected.date.day_of_week = (expected.date.unix_date + 4) % 7;
+	gregorian_date_time_calculate_unix_time(&expected);
+	// The clock starts along with the monotonic clock, as in
+	// gregorian_calendar_init.
+	expected.epoch_monotime = -(expected.unix_time << 8);
+
+	gregorian_calendar_set(&expected);
+
+	for (uint16_t second = 0; second < SECONDS; second++) {
+		const struct gregorian_date_time *now =
+			gregorian_calendar_now();
+
+		CHECK(now->unix_era == expected.unix_era &&
+		      now->unix_time == expected.unix_time &&
+		      now->epoch_monotime == expected.epoch_monotime,
+		      "second %d: UNIX time %d:%u, not %d:%u", second,
+		      now->unix_era, now->unix_time, expected.unix_era,
+		      expected.unix_time);
+		CHECK(now->time.hour == expected.time.hour &&
+		      now->time.minute == expected.time.minute &&
+		      now->time.second == expected.time.second &&
+		      now->timezone == expected.timezone,
+		      "second %d: %02d:%02d:%02d (%d), not %02d:%02d:%02d (%d)",
+		      second, now->time.hour, now->time.minute,
+		      now->time.second, now->timezone, expected.time.hour,
+		      expected.time.minute, expected.time.second,
+		      expected.timezone);
+		CHECK(now->date.year == expected.date.year &&
+		      now->date.month == expected.date.month &&
+		      now->date.day_of_month == expected.date.day_of_month &&
+		      now->date.day_of_week == expected.date.day_of_week &&
+		      now->date.unix_date == expected.date.unix_date,
+		      "second %d: %02d-%02d-%02d, not %02d-%02d-%02d", second,
+		      now->date.year, now->date.month, now->date.day_of_month,
+		      expected.date.year, expected.date.month,
+		      expected.date.day_of_month);
+		CHECK(now->timezone_change_announced ==
+		      expected.timezone_change_announced &&
+		      now->time.leap_second_announced ==
+		      expected.time.leap_second_announced,
+		      "second %d: announcements %d/%d, not %d/%d", second,
+		      now->timezone_change_announced,
+		      now->time.leap_second_announced,
+		      expected.timezone_change_announced,
+		      expected.time.leap_second_announced);
+
+		gregorian_date_time_increment(&expected);
+		gregorian_calendar_tick();
+	}
+}
+
+static void test_cest_start() {
+	run_clock(20, 26, 3, 29, 1, 30, 1, 1, 0);
+}
+
+static void test_cest_end() {
+	run_clock(20, 26, 10, 25, 2, 30, 2, 1, 0);
+}
+
+static void test_leap_second() {
+	run_clock(20, 17, 1, 1, 0, 10, 1, 0, 1);
+}
+
+static void test_new_year() {
+	run_clock(20, 26, 12, 31, 23, 10, 1, 0, 0);
+}
+
+/**
+ * The UNIX time wraps around at 2106-02-07 07:28:16 CET, in the hour of an
+ * announced timezone change and leap second.
+ */
+static void test_era() {
+	run_clock(21, 6, 2, 7, 6, 30, 1, 1, 1);
+}
+
+int main() {
+	test_case("clock: CEST start", test_cest_start);
+	test_case("clock: CEST end", test_cest_end);
+	test_case("clock: leap second", test_leap_second);
+	test_case("clock: new year", test_new_year);
+	test_case("clock: era", test_era);
+
+	return test_report("test_clock");
+}
@@ -0,0 +1,167 @@
+// Host test of the frame schema (see dcf_frame.h): encoding and decoding of
+// random date-times, and the field reads against a bit-by-bit reader.
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "dcf_frame.h"
+#include "util.h"
+#include "test.h"
+
+// Not declared in a header; only used by dcf_processor.c.
+uint8_t find_index_of_highest_bit(uint64_t *val);
+
+#define FRAMES 100000
+
+/**
+ * Returns a random date-time; the fields are in range, but not necessarily
+ * a valid date.
+ */
+static struct gregorian_date_time random_date_time() {
+	struct gregorian_date_time datetime = {0};
+
+	datetime.time.minute = rand() % 60;
+	datetime.time.hour = rand() % 24;
+	datetime.date.day_of_month = 1 + rand() % 31;
+	datetime.date.day_of_week = rand() % 7;
+	datetime.date.month = 1 + rand() % 12;
+	datetime.date.year = rand() % 100;
+	datetime.timezone = rand() % 2 ? 1 : 2;
+	datetime.call_bit = rand() & 1;
+	datetime.time.leap_second_announced = rand() & 1;
+	datetime.timezone_change_announced = rand() & 1;
+
+	return datetime;
+}
+
+/**
+ * Every date-time decodes to what it was encoded from.
+ */
+static void test_round_trip() {
+	srand(1);
+
+	for (long n = 0; n < FRAMES; n++) {
+		struct gregorian_date_time datetime = random_date_time();
+		uint64_t bits = dcf_frame_encode(&datetime);
+		uint8_t values[DCF_VALUE_COUNT];
+
+		CHECK(!(bits >> 59), "bits beyond the frame: %016llx",
+		      (unsigned long long) bits);
+		CHECK(dcf_frame_decode(bits, values, DCF_GROUPS_ALL),
+		      "encoded frame %016llx not decoded",
+		      (unsigned long long) bits);
+
+		uint8_t day_of_week = datetime.date.day_of_week ?
+		                      datetime.date.day_of_week : 7;
+		CHECK(values[DCF_VALUE_MINUTE] == datetime.time.minute &&
+		      values[DCF_VALUE_HOUR] == datetime.time.hour &&
+		      values[DCF_VALUE_DAY_OF_MONTH] ==
+		      datetime.date.day_of_month &&
+		      values[DCF_VALUE_DAY_OF_WEEK] == day_of_week &&
+		      values[DCF_VALUE_MONTH] == datetime.date.month &&
+		      values[DCF_VALUE_YEAR] == datetime.date.year,
+		      "frame %016llx decoded to a different date-time",
+		      (unsigned long long) bits);
+		CHECK(values[DCF_VALUE_CET] == (datetime.timezone == 1) &&
+		      values[DCF_VALUE_CEST] == (datetime.timezone == 2) &&
+		      values[DCF_VALUE_CALL_BIT] == datetime.call_bit &&
+		      values[DCF_VALUE_START] == 1,
+		      "frame %016llx decoded to different flags",
+		      (unsigned long long) bits);
+	}
+}
+
+/**
+ * A single flipped bit in any of the parity groups (minute, hour, date) is
+ * detected.
+ */
+static void test_parity() {
+	srand(2);
+
+	for (long n = 0; n < FRAMES; n++) {
+		struct gregorian_date_time datetime = random_date_time();
+		uint64_t bits = dcf_frame_encode(&datetime);
+		uint8_t values[DCF_VALUE_COUNT];
+
+		// Bit 58 - n is transmitted in second n, so the groups span
+		// the bits 0 (the date parity) to 37 (the first minute bit).
+		uint8_t flipped = rand() % 38;
+		uint64_t received = bits ^ ((uint64_t) 1 << flipped);
+		CHECK(!dcf_frame_decode(received, values, DCF_GROUPS_ALL),
+		      "frame %016llx with bit %d flipped decoded",
+		      (unsigned long long) bits, flipped);
+	}
+}
+
+/**
+ * Reads a field bit by bit, as the decoder did before the schema.
+ */
+static uint8_t read_field_bitwise(uint64_t bits, uint8_t pos, uint8_t width) {
+	uint8_t value = 0;
+	for (uint8_t i = 0; i < width; i++) {
+		value |= BIT(bits, pos - i) << i;
+	}
+
+	return value;
+}
+
+static uint64_t random_bits() {
+	uint64_t bits = ((uint64_t) rand() << 33) ^ ((uint64_t) rand() << 10) ^
+	                (uint64_t) rand();
+	return bits & (((uint64_t) 1 << 60) - 1);
+}
+
+/**
+ * Field reads and writes agree with the bit-by-bit reader.
+ */
+static void test_fields() {
+	srand(3);
+
+	for (long n = 0; n < FRAMES; n++) {
+		uint64_t bits = random_bits();
+		uint8_t width = 1 + rand() % 8;
+		uint8_t pos = width - 1 + rand() % (60 - width + 1);
+
+		uint8_t value = dcf_frame_read_field(bits, pos, width);
+		CHECK(value == read_field_bitwise(bits, pos, width),
+		      "field of %d bits at %d of %016llx read as %d", width,
+		      pos, (unsigned long long) bits, value);
+
+		uint8_t written = rand() & ((1 << width) - 1);
+		uint64_t modified = dcf_frame_write_field(bits, pos, width,
+		                                          written);
+		CHECK(read_field_bitwise(modified, pos, width) == written,
+		      "field of %d bits at %d not written", width, pos);
+		uint64_t mask = (((uint64_t) 1 << width) - 1) <<
+		                (pos - width + 1);
+		CHECK((modified & ~mask) == (bits & ~mask),
+		      "field of %d bits at %d written beyond it", width, pos);
+	}
+}
+
+/**
+ * The highest bit is found for every position.
+ */
+static void test_highest_bit() {
+	srand(4);
+
+	for (long n = 0; n < FRAMES; n++) {
+		uint64_t value = random_bits() >> (rand() % 60);
+		if (!value) {
+			continue;
+		}
+
+		uint8_t index = find_index_of_highest_bit(&value);
+		CHECK(value >> index == 1, "highest bit of %016llx found at %d",
+		      (unsigned long long) value, index);
+	}
+}
+
+int main() {
+	test_case("frame: round trip", test_round_trip);
+	test_case("frame: parity", test_parity);
+	test_case("frame: fields", test_fields);
+	test_case("frame: highest bit", test_highest_bit);
+
+	return test_report("test_frame");
+}
@@ -0,0 +1,227 @@
+// Host test of the reception of whole minutes: the receiver, the frame
+// processor and the clock they set, driven by an emulated DCF77 signal (see
+// simulation.h).
+
+#include <stdint.h>
+
+#include "simulation.h"
+#include "test.h"
+
+// The calls of gregorian_date_validate (the test is linked with
+// --wrap=gregorian_date_validate).
+static long validations = 0;
+
+uint8_t __real_gregorian_date_validate(struct gregorian_date *date);
+
+uint8_t __wrap_gregorian_date_validate(struct gregorian_date *date) {
+	validations++;
+	return __real_gregorian_date_validate(date);
+}
+
+// The minute that is being emitted by receive_minutes, from 0.
+static uint8_t current_minute;
+
+/**
+ * Checks that the clock shows the start of the given minute (from 12:10
+ * on), once the frame of the minute before has been decoded.
+ */
+static void check_minute(uint8_t minute) {
+	const struct gregorian_date_time *now = gregorian_calendar_now();
+
+	CHECK(now->time.hour == 12 && now->time.minute == 10 + minute &&
+	      now->time.second == 0, "clock at %02d:%02d:%02d, not 12:%02d:00",
+	      now->time.hour, now->time.minute, now->time.second, 10 + minute);
+}
+
+/**
+ * Emits the minutes from 12:10 on Saturday, 2026-10-17 (CEST) on, and
+ * checks that the clock shows the start of each minute after the first
+ * pulse of it, once a frame has been decoded.
+ *
+ * @param minutes:
+ *     The number of minutes to emit; the marker at the end of the last one
+ *     is up to the caller.
+ * @param pulse_ms:
+ *     Returns the pulse length in each second of current_minute (see
+ *     simulation_minute), or NULL for undisturbed minutes.
+ * @param minute_bits:
+ *     If not NULL, may change the bits of the given minute.
+ * @returns
+ *     The start of the next minute.
+ */
+static uint64_t receive_minutes(uint8_t minutes,
+	uint16_t (*pulse_ms)(uint8_t second, uint8_t bit),
+	void (*minute_bits)(uint8_t minute, uint8_t bits[60])) {
+
+	uint64_t start = SIMULATION_START;
+	for (uint8_t minute = 0; minute < minutes; minute++) {
+		uint8_t bits[60];
+		test_encode_minute(bits, 10 + minute, 12, 17, 6, 10, 26, 1);
+		if (minute_bits) {
+			minute_bits(minute, bits);
+		}
+
+		current_minute = minute;
+		for (uint8_t second = 0; second < 59; second++) {
+			uint16_t length = pulse_ms ?
+				pulse_ms(second, bits[second]) :
+				bits[second] ? 200 : 100;
+			if (length) {
+				simulation_pulse(start + second * SIMULATION_HZ,
+				                 length);
+			}
+			if (second == 0 && simulation_frames_ok) {
+				check_minute(minute);
+			}
+		}
+
+		start += 60 * SIMULATION_HZ;
+	}
+
+	return start;
+}
+
+/**
+ * A pulse of an illegal length in one minute, and a missing pulse in the
+ * next one.
+ */
+static uint16_t erasure_pulse_ms(uint8_t second, uint8_t bit) {
+	if (current_minute == 3 && second == 24) {
+		return 350;
+	}
+	if (current_minute == 4 && second == 40) {
+		return 0;
+	}
+
+	return bit ? 200 : 100;
+}
+
+/**
+ * Seconds that can't be read don't cost the minute; they are restored from
+ * the parity.
+ */
+static void test_erasures() {
+	simulation_init();
+	uint64_t start = receive_minutes(6, erasure_pulse_ms, NULL);
+	simulation_pulse(start, 100);
+	check_minute(6);
+
+	CHECK(simulation_frames_ok == 6 && simulation_frames_bad == 0,
+	      "%ld frames decoded, %ld rejected", simulation_frames_ok,
+	      simulation_frames_bad);
+}
+
+/**
+ * Emits a minute where a short spike follows each pulse, and each 1 pulse
+ * has a dropout in it.
+ */
+static void test_glitches() {
+	simulation_init();
+	uint64_t start = receive_minutes(2, NULL, NULL);
+
+	uint8_t bits[60];
+	test_encode_minute(bits, 12, 12, 17, 6, 10, 26, 1);
+	for (uint8_t second = 0; second < 59; second++) {
+		uint64_t rise = start + second * SIMULATION_HZ;
+		uint64_t fall = rise + (bits[second] ? 200 : 100) *
+		                SIMULATION_HZ / 1000;
+		simulation_edge(rise, 1);
+		if (bits[second]) {
+			simulation_edge(rise + SIMULATION_HZ * 150 / 1000, 0);
+			simulation_edge(rise + SIMULATION_HZ * 155 / 1000, 1);
+		}
+		simulation_edge(fall, 0);
+		simulation_edge(fall + SIMULATION_HZ * 300 / 1000, 1);
+		simulation_edge(fall + SIMULATION_HZ * 303 / 1000, 0);
+	}
+	simulation_pulse(start + 60 * SIMULATION_HZ, 100);
+	check_minute(3);
+
+	CHECK(simulation_frames_ok == 3 && simulation_frames_bad == 0,
+	      "%ld frames decoded, %ld rejected", simulation_frames_ok,
+	      simulation_frames_bad);
+	CHECK(dcf_glitch_count >= 59, "%u glitches absorbed",
+	      dcf_glitch_count);
+}
+
+/**
+ * The minute-end marker is reported once DCF_GLITCH_MAX has passed after
+ * it, even if the signal ends with it.
+ */
+static void test_held_edge() {
+	simulation_init();
+	uint64_t start = receive_minutes(2, NULL, NULL);
+
+	long decoded = simulation_frames_ok;
+	simulation_edge(start, 1);
+	simulation_idle(start + SIMULATION_HZ * 50 / 1000, SIMULATION_HZ / 100);
+
+	CHECK(simulation_frames_ok == decoded + 1,
+	      "marker not reported 50 ms after it");
+	check_minute(2);
+}
+
+/**
+ * Two flipped bits in one minute, a third of the bits missing in the next,
+ * and a minute with the wrong time and a flipped bit.
+ */
+static void corrected_bits(uint8_t minute, uint8_t bits[60]) {
+	if (minute == 4) {
+		bits[22] = !bits[22];
+		bits[31] = !bits[31];
+	} else if (minute == 6) {
+		test_encode_minute(bits, 40, 12, 17, 6, 10, 26, 1);
+		bits[30] = !bits[30];
+	}
+}
+
+static uint16_t corrected_pulse_ms(uint8_t second, uint8_t bit) {
+	if (current_minute == 5 && second >= 21 && second % 4 == 1) {
+		return 0;
+	}
+
+	return bit ? 200 : 100;
+}
+
+/**
+ * Once the clock is set, frames that don't pass the checks are corrected
+ * by the frame predicted from the clock, but a frame with a different time
+ * doesn't move the clock.
+ */
+static void test_corrected() {
+	simulation_init();
+	uint64_t start = receive_minutes(8, corrected_pulse_ms, corrected_bits);
+	simulation_pulse(start, 100);
+	check_minute(8);
+
+	printf("%ld frames decoded, %ld rejected; %u clean, %u corrected\n",
+	       simulation_frames_ok, simulation_frames_bad, dcf_frames_clean,
+	       dcf_frames_corrected);
+	CHECK(dcf_frames_corrected >= 2, "%u frames corrected",
+	      dcf_frames_corrected);
+	CHECK(simulation_frames_ok + simulation_frames_bad == 8,
+	      "%ld frames", simulation_frames_ok + simulation_frames_bad);
+}
+
+/**
+ * The date is only validated once while it doesn't change.
+ */
+static void test_date_cache() {
+	simulation_init();
+	uint64_t start = receive_minutes(7, NULL, NULL);
+	simulation_pulse(start, 100);
+
+	CHECK(simulation_frames_ok == 7, "%ld frames decoded",
+	      simulation_frames_ok);
+	CHECK(validations == 1, "%ld date validations", validations);
+}
+
+int main() {
+	test_case("receiver: erasures", test_erasures);
+	test_case("receiver: glitches", test_glitches);
+	test_case("receiver: held edge", test_held_edge);
+	test_case("receiver: corrected frames", test_corrected);
+	test_case("receiver: date cache", test_date_cache);
+
+	return test_report("test_receiver");
+}
@@ -0,0 +1,120 @@
+// Host test of the realignment of frames in which a second is missing or
+// doubled (see dcf_process_frame).
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "dcf_classifier.h"
+#include "dcf_frame.h"
+#include "dcf_processor.h"
+#include "gregorian_calendar.h"
+#include "test.h"
+
+// Not declared in a header; only used by dcf_process.
+uint8_t dcf_process_frame(struct dcf_frame *frame, uint64_t *predicted);
+
+#define DATES 3000
+
+/**
+ * Sets up a frame of the given number of received bits, all of them
+ * confident.
+ */
+static void make_frame(struct dcf_frame *frame, uint64_t bits,
+	uint8_t count) {
+
+	frame->bits = bits | ((uint64_t) 1 << count);
+	frame->erasures = 0;
+	frame->timestamp_monotime = 0;
+	for (uint8_t i = 0; i < DCF_FRAME_MAX_BITS; i++) {
+		frame->confidence[i] = DCF_CONFIDENCE_MAX;
+	}
+}
+
+/**
+ * Decodes the given frame, and returns 1 if it has been accepted, setting
+ * *wrong if it has been decoded to another time than the given one.
+ */
+static uint8_t decode(struct dcf_frame *frame, uint64_t *predicted,
+	uint32_t unix_time, long *wrong) {
+
+	current_date_time.unix_time = 0;
+	if (!dcf_process_frame(frame, predicted)) {
+		return 0;
+	}
+
+	if (current_date_time.unix_time != unix_time) {
+		(*wrong)++;
+	}
+	return 1;
+}
+
+/**
+ * Every second of random frames is dropped or doubled in turn; the frames
+ * are decoded without and with the prediction of the actual frame.
+ */
+static void test_slips() {
+	long tried = 0;
+	long accepted = 0, wrong = 0;
+	long accepted_predicted = 0, wrong_predicted = 0;
+
+	srand(1);
+	for (uint16_t n = 0; n < DATES; n++) {
+		struct gregorian_date_time datetime = {0};
+		datetime.date.century = 20;
+		datetime.date.year = rand() % 100;
+		datetime.date.month = 1 + rand() % 12;
+		datetime.date.day_of_month = 1 + rand() % 28;
+		datetime.time.hour = rand() % 24;
+		datetime.time.minute = rand() % 60;
+		datetime.timezone = 1 + rand() % 2;
+		gregorian_date_calculate_unix_date(&datetime.date);
+		// 1970-01-01 was a thursday
+		datetime.date.day_of_week = (datetime.date.unix_date + 4) % 7;
+
+		// With random weather bits.
+		uint64_t bits = dcf_frame_encode(&datetime) |
+		                ((uint64_t) (rand() & 0x3fff) << 44);
+
+		struct dcf_frame frame;
+		make_frame(&frame, bits, DCF_FRAME_BITS);
+		CHECK(dcf_process_frame(&frame, NULL),
+		      "aligned frame rejected");
+		uint32_t unix_time = current_date_time.unix_time;
+
+		// Bit 58 - bit is transmitted in second bit, which is missing
+		// or received twice.
+		for (uint8_t bit = 0; bit < DCF_FRAME_BITS; bit++) {
+			uint64_t low = bits & (((uint64_t) 1 << bit) - 1);
+			uint64_t high = bits >> bit;
+
+			for (uint8_t doubled = 0; doubled <= 1; doubled++) {
+				uint64_t slipped = low | (doubled ?
+					((high << 1) | (high & 1)) << bit :
+					(high >> 1) << bit);
+				uint8_t count = doubled ? DCF_FRAME_BITS + 1 :
+				                DCF_FRAME_BITS - 1;
+				tried++;
+
+				make_frame(&frame, slipped, count);
+				accepted += decode(&frame, NULL, unix_time,
+				                   &wrong);
+
+				make_frame(&frame, slipped, count);
+				accepted_predicted += decode(&frame, &bits,
+					unix_time, &wrong_predicted);
+			}
+		}
+	}
+
+	printf("%ld slipped frames: %ld accepted (%ld wrong); with the "
+	       "prediction %ld accepted (%ld wrong)\n", tried, accepted, wrong,
+	       accepted_predicted, wrong_predicted);
+	CHECK(wrong == 0 && wrong_predicted == 0, "frames decoded wrong");
+	CHECK(accepted_predicted == tried, "frames not realigned");
+}
+
+int main() {
+	test_case("slip: realignment", test_slips);
+
+	return test_report("test_slip");
+}
@@ -0,0 +1,100 @@
+// Host test of the time zone rules (see timezone.h) against the system's
+// time zone database.
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "timezone.h"
+#include "test.h"
+
+// The zones of the database that the rules stand for, by TIMEZONE_*.
+static const char *database_names[TIMEZONE_COUNT] = {
+	"UTC", "Europe/London", "Europe/Berlin", "Europe/Helsinki",
+	"Europe/Moscow", "Asia/Kolkata", "America/New_York", "America/Chicago",
+	"America/Denver", "America/Los_Angeles", "Australia/Sydney",
+};
+
+// 2015-01-01, 2008-01-01 (the US rules have changed in 2007) and
+// 2038-01-01, in UTC.
+#define START 1420070400LL
+#define START_US 1199145600LL
+#define END 2145916800LL
+
+/**
+ * Converts UTC times with the given rule, stepping through the years in
+ * steps of 10 to 30 minutes, and compares the local times and the
+ * abbreviations with localtime_r.
+ */
+static void check_zone(uint8_t rule) {
+	setenv("TZ", database_names[rule], 1);
+	tzset();
+
+	struct timezone_state zone;
+	timezone_init(&zone, rule);
+
+	// The database doesn't use the same abbreviations for these.
+	uint8_t check_name = rule != TIMEZONE_UTC && rule != TIMEZONE_WET &&
+	                     rule != TIMEZONE_MSK;
+
+	long step = 0;
+	long long start = rule >= TIMEZONE_US_EASTERN &&
+	                  rule <= TIMEZONE_US_PACIFIC ? START_US : START;
+	for (long long time = start; time < END;
+	     time += 599 + (step % 3) * 600, step++) {
+
+		struct gregorian_date_time utc = {0};
+		struct gregorian_date_time local = {0};
+		gregorian_date_time_from_unix_time_offset(&utc, 0,
+			(uint32_t) time, 0);
+		timezone_convert(&zone, &utc, &local);
+
+		time_t reference_time = time;
+		struct tm reference;
+		localtime_r(&reference_time, &reference);
+
+		CHECK(local.time.hour == reference.tm_hour &&
+		      local.time.minute == reference.tm_min &&
+		      local.date.day_of_month == reference.tm_mday &&
+		      local.date.month == reference.tm_mon + 1 &&
+		      local.date.day_of_week == reference.tm_wday,
+		      "%s at %lld: %02d-%02d %02d:%02d, "
+		      "not %02d-%02d %02d:%02d", database_names[rule], time,
+		      local.date.month, local.date.day_of_month,
+		      local.time.hour, local.time.minute, reference.tm_mon + 1,
+		      reference.tm_mday, reference.tm_hour, reference.tm_min);
+		CHECK(!check_name || !strcmp(zone.name, reference.tm_zone),
+		      "%s at %lld: %s, not %s", database_names[rule], time,
+		      zone.name, reference.tm_zone);
+	}
+
+	// A jump back in time.
+	struct gregorian_date_time utc = {0};
+	struct gregorian_date_time local = {0};
+	gregorian_date_time_from_unix_time_offset(&utc, 0, 1500000000, 0);
+	timezone_convert(&zone, &utc, &local);
+
+	time_t reference_time = 1500000000;
+	struct tm reference;
+	localtime_r(&reference_time, &reference);
+	CHECK(local.time.hour == reference.tm_hour &&
+	      local.time.minute == reference.tm_min,
+	      "%s after jumping back: %02d:%02d, not %02d:%02d",
+	      database_names[rule], local.time.hour, local.time.minute,
+	      reference.tm_hour, reference.tm_min);
+}
+
+static void test_zones() {
+	for (uint8_t rule = 0; rule < TIMEZONE_COUNT; rule++) {
+		check_zone(rule);
+	}
+}
+
+int main() {
+	test_case("timezone: zones", test_zones);
+
+	return test_report("test_timezone");
+}
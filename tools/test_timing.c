@@ -0,0 +1,281 @@
+// Host test of the timing of the clock: the disciplining of the oscillator,
+// the estimate of the clock's offset, the accuracy of the second ticks and
+// (with PPS_OUTPUT) of the pulses, with an emulated resonator that is off
+// by some ppm and a DCF77 signal with jittery edges (see simulation.h).
+//
+// Built once for each mode of the monotonic clock, with and without PPS.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "simulation.h"
+#include "test.h"
+
+#ifdef MONOTIME_TICKLESS
+#define MODE "tickless"
+#else
+#define MODE "periodic"
+#endif
+
+/**
+ * Emits the given number of minutes from 10:00 on Saturday, 2026-10-17
+ * (CEST) on, followed by the marker of the last one.
+ *
+ * @param measure_from:
+ *     The minute from which on the ticks and pulses are recorded in the
+ *     given errors (which may be NULL).
+ * @returns
+ *     The start of the next minute, i.e. the last marker.
+ */
+static uint64_t receive(uint16_t minutes, uint16_t measure_from,
+	struct simulation_errors *ticks, struct simulation_errors *pulses) {
+
+	uint64_t start = SIMULATION_START;
+	for (uint16_t minute = 0; minute < minutes; minute++) {
+		if (minute == measure_from) {
+			simulation_ticks = ticks;
+			simulation_pulses = pulses;
+		}
+
+		uint8_t bits[60];
+		test_encode_minute(bits, minute % 60, 10 + minute / 60, 17, 6,
+		                   10, 26, 1);
+		start = simulation_minute(start, bits, NULL);
+	}
+	simulation_pulse(start, 100);
+
+	return start;
+}
+
+/**
+ * Returns the seconds since the clock's epoch.
+ */
+static double clock_seconds() {
+	return (uint32_t) (monotime_current_get() -
+	                   current_date_time.epoch_monotime) / 256.0;
+}
+
+/**
+ * Receives 3 hours of frames with +-10 ms jitter, then lets an hour pass
+ * without signal, and compares the drift of the clock with the estimate
+ * of the frequency error (if simulation_discipline) and of the offset.
+ */
+static void test_holdover() {
+	srand(7);
+	simulation_jitter = 10000;
+	simulation_init();
+
+	uint64_t marker = receive(180, 180, NULL, NULL);
+	simulation_idle(marker + SIMULATION_HZ / 2, SIMULATION_HZ);
+	double reading = clock_seconds();
+
+	simulation_idle(marker + SIMULATION_HZ / 2 + 3600 * SIMULATION_HZ,
+	                SIMULATION_HZ);
+	double drift = clock_seconds() - reading - 3600;
+	struct time_estimate estimate;
+	CHECK(time_estimator_get(&estimate), "no estimate");
+
+	double error = oscillator_error / (double) MONOTIME_PPM_SCALE;
+	printf("%+.0f ppm (%s): %ld frames decoded, frequency error "
+	       "estimated at %+.2f ppm; after 1 h without signal, the clock is "
+	       "off by %+.1f ms, estimated %+.1f ms within %.1f ms\n",
+	       simulation_ppm, simulation_discipline ? "disciplined" :
+	       "undisciplined", simulation_frames_ok, error, drift * 1e3,
+	       estimate.offset / 1e3, estimate.bound / 1e3);
+
+	CHECK(simulation_frames_ok >= 178 && simulation_frames_bad == 0,
+	      "%ld frames decoded, %ld rejected", simulation_frames_ok,
+	      simulation_frames_bad);
+	if (simulation_discipline) {
+		CHECK(fabs(error - simulation_ppm) < 5,
+		      "frequency error estimated at %.2f ppm", error);
+		CHECK(fabs(drift) < 0.025, "clock off by %.1f ms", drift * 1e3);
+	} else {
+		CHECK(fabs(drift - simulation_ppm * 3600e-6) < 0.025,
+		      "clock off by %.1f ms", drift * 1e3);
+	}
+	CHECK(fabs(estimate.offset / 1e6 - drift) < 0.025,
+	      "offset estimated at %.1f ms", estimate.offset / 1e3);
+	CHECK(fabs(drift) * 1e6 <= estimate.bound,
+	      "offset of %.1f ms beyond the bound of %.1f ms", drift * 1e3,
+	      estimate.bound / 1e3);
+}
+
+/**
+ * Receives 3 hours of frames with +-3 ms jitter and a +300 ppm resonator,
+ * and measures the second ticks (and pulses) against the second starts of
+ * the signal from minute 30 on.
+ *
+ * With PPS_OUTPUT, then lets the time pass without signal until the pulses
+ * stop.
+ */
+static void test_accuracy() {
+	srand(7);
+	simulation_ppm = 300;
+	simulation_jitter = 3000;
+	simulation_init();
+
+	struct simulation_errors ticks = {0};
+	struct simulation_errors pulses = {0};
+	uint64_t marker = receive(180, 30, &ticks, &pulses);
+	simulation_idle(marker + SIMULATION_HZ / 2, SIMULATION_HZ);
+	simulation_ticks = NULL;
+	simulation_pulses = NULL;
+
+	printf("%s, +-3 ms jitter: %ld second ticks, mean %+.0f us, "
+	       "rms %.0f us, max %.0f us\n", MODE, ticks.count,
+	       simulation_mean(&ticks), simulation_rms(&ticks), ticks.max);
+	CHECK(simulation_double_ticks == 0, "%ld seconds ticked twice",
+	      simulation_double_ticks);
+	// Minute 30 to the second after the marker.
+	CHECK(labs(ticks.count - (150 * 60 + 1)) <= 1, "%ld ticks",
+	      ticks.count);
+	CHECK(simulation_rms(&ticks) < 1000 && ticks.max < 3000,
+	      "ticks rms %.0f us, max %.0f us", simulation_rms(&ticks),
+	      ticks.max);
+
+#ifdef MONOTIME_TICKLESS
+	double seconds = (double) simulation_time / SIMULATION_HZ;
+	printf("interrupts: %ld overflow, %ld compare in %.0f s\n",
+	       simulation_overflows, simulation_compares, seconds);
+	// An overflow every 65536 * 1024 cycles, a compare per second.
+	CHECK(fabs(simulation_overflows - seconds * 16e6 *
+	           (1 + simulation_ppm * 1e-6) / 65536 / 1024) <= 1,
+	      "%ld overflows", simulation_overflows);
+	CHECK(simulation_compares <= seconds + 1, "%ld compares",
+	      simulation_compares);
+#endif
+
+#ifdef PPS_OUTPUT
+	printf("pulses: %ld, mean %+.0f us, rms %.0f us, max %.0f us; widths "
+	       "%.2f to %.2f ms\n", pulses.count, simulation_mean(&pulses),
+	       simulation_rms(&pulses), pulses.max, simulation_width_min / 1e3,
+	       simulation_width_max / 1e3);
+	CHECK(simulation_double_pulses == 0, "%ld seconds with two pulses",
+	      simulation_double_pulses);
+	CHECK(labs(pulses.count - ticks.count) <= 1, "%ld pulses",
+	      pulses.count);
+	CHECK(simulation_rms(&pulses) < 1000 && pulses.max < 3000,
+	      "pulses rms %.0f us, max %.0f us", simulation_rms(&pulses),
+	      pulses.max);
+	// Within 0.1 ms, plus a count of the periodic timer.
+	CHECK(simulation_width_min > PPS_WIDTH * 1e3 - 101 &&
+	      simulation_width_max < PPS_WIDTH * 1e3 + 101,
+	      "widths %.1f to %.1f us", simulation_width_min,
+	      simulation_width_max);
+
+	// The pulses stop once the bound exceeds PPS_MAX_BOUND.
+	uint64_t time = simulation_time;
+	long seconds_without_signal = 0;
+	long pulse_count;
+	do {
+		pulse_count = simulation_pulse_count;
+		time += SIMULATION_HZ;
+		simulation_idle(time, SIMULATION_HZ);
+		seconds_without_signal++;
+	} while (simulation_pulse_count > pulse_count &&
+	         seconds_without_signal < 6 * 3600);
+
+	struct time_estimate estimate;
+	time_estimator_get(&estimate);
+	printf("pulses stop after %.1f h without signal, at a bound of "
+	       "%.1f ms\n", seconds_without_signal / 3600.0,
+	       estimate.bound / 1e3);
+	CHECK(seconds_without_signal > 3600 &&
+	      seconds_without_signal < 6 * 3600, "pulses stop after %ld s",
+	      seconds_without_signal);
+
+	simulation_idle(time + 60 * SIMULATION_HZ, SIMULATION_HZ);
+	CHECK(simulation_pulse_count == pulse_count, "pulses without lock");
+#endif
+}
+
+// Without jitter, the second starts are only resolved in 1/256 s by the
+// receiver, so the clock is off by up to half of that.
+#define SET_TOLERANCE 2500
+
+/**
+ * Sets the clock in the middle of a second, with the epoch moved by the
+ * given number of units, and checks the ticks (and pulses) of the next
+ * 10 seconds.
+ */
+static void check_set(int8_t step, double expected_deviation) {
+	struct gregorian_date_time datetime = *gregorian_calendar_now();
+	datetime.epoch_monotime += step;
+
+	long tick_count = simulation_tick_count;
+	long double_ticks = simulation_double_ticks;
+	long pulse_count = simulation_pulse_count;
+	long double_pulses = simulation_double_pulses;
+	struct simulation_errors ticks = {0};
+	struct simulation_errors pulses = {0};
+	simulation_ticks = &ticks;
+	simulation_pulses = &pulses;
+
+	gregorian_calendar_set(&datetime);
+	simulation_idle(simulation_time + 10 * SIMULATION_HZ,
+	                SIMULATION_HZ / 10);
+
+	CHECK(simulation_tick_count - tick_count == 10 &&
+	      simulation_double_ticks == double_ticks,
+	      "epoch moved by %d: %ld ticks in 10 s, %ld twice", step,
+	      simulation_tick_count - tick_count,
+	      simulation_double_ticks - double_ticks);
+	CHECK(fabs(simulation_mean(&ticks) - expected_deviation) <
+	      SET_TOLERANCE,
+	      "epoch moved by %d: ticks %.0f us off", step,
+	      simulation_mean(&ticks));
+#ifdef PPS_OUTPUT
+	CHECK(simulation_pulse_count - pulse_count == 10 &&
+	      simulation_double_pulses == double_pulses,
+	      "epoch moved by %d: %ld pulses in 10 s, %ld twice", step,
+	      simulation_pulse_count - pulse_count,
+	      simulation_double_pulses - double_pulses);
+	CHECK(fabs(simulation_mean(&pulses) - expected_deviation) <
+	      SET_TOLERANCE,
+	      "epoch moved by %d: pulses %.0f us off", step,
+	      simulation_mean(&pulses));
+#else
+	(void) pulse_count;
+	(void) double_pulses;
+#endif
+
+	simulation_ticks = NULL;
+	simulation_pulses = NULL;
+}
+
+/**
+ * Setting the clock doesn't count a second twice or skip one, neither
+ * with the same epoch, nor with one that is moved forward or back.
+ */
+static void test_set() {
+	simulation_init();
+
+	uint64_t marker = receive(10, 10, NULL, NULL);
+	simulation_idle(marker + SIMULATION_HZ / 2, SIMULATION_HZ / 10);
+
+	// A unit is 1/256 s.
+	check_set(0, 0);
+	check_set(26, 26e6 / 256);
+	check_set(-52, -26e6 / 256);
+}
+
+int main() {
+	simulation_ppm = -450;
+	test_case("timing (" MODE "): disciplined -450 ppm", test_holdover);
+	simulation_ppm = 300;
+	test_case("timing (" MODE "): disciplined +300 ppm", test_holdover);
+	simulation_ppm = 800;
+	test_case("timing (" MODE "): disciplined +800 ppm", test_holdover);
+	simulation_ppm = 300;
+	simulation_discipline = 0;
+	test_case("timing (" MODE "): undisciplined +300 ppm", test_holdover);
+	simulation_ppm = 0;
+	simulation_discipline = 1;
+
+	test_case("timing (" MODE "): accuracy", test_accuracy);
+	test_case("timing (" MODE "): clock set", test_set);
+
+	return test_report("test_timing");
+}
@@ -28,3 +28,24 @@ void print_binary_8(FILE *f, uint8_t val) {
 		mask >>= 1;
 	}
 }
+
+uint32_t isqrt(uint64_t value) {
+	uint64_t result = 0;
+	uint64_t bit = (uint64_t) 1 << 62;
+
+	while (bit > value) {
+		bit >>= 2;
+	}
+
+	while (bit) {
+		if (value >= result + bit) {
+			value -= result + bit;
+			result = (result >> 1) + bit;
+		} else {
+			result >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return (uint32_t) result;
+}
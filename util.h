@@ -7,9 +7,18 @@
 #define UNUSED(X) ((void)(X))
 #define BIT(X, POS) (((uint64_t) (X) & ((uint64_t) 1 << (POS))) ? 1 : 0)
 
+// Keeps the compiler from moving memory accesses across it (e.g. out of a
+// loop that retries reading data that an ISR may change).
+#define MEMORY_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
 void print_binary_64(FILE *f, uint64_t val);
 void print_binary_32(FILE *f, uint32_t val);
 void print_binary_16(FILE *f, uint16_t val);
 void print_binary_8(FILE *f, uint8_t val);
 
+/**
+ * Returns the integer square root of the given value, rounded down.
+ */
+uint32_t isqrt(uint64_t value);
+
 #endif